@@ -22,36 +22,36 @@ AllDifferentFamily::AllDifferentFamily(std::vector<int> _variables, const std::u
 }
 
 void AllDifferentFamily::add(int var, int value) {
-    if (!valToVar.at(value).emplace(var).second) return;
+    if (!varNodes.insert(valToVar.at(value), var)) return;
     switch (valToVar.at(value).size())
     {
     case 1:
         nbValPossible++;
-        uniqueValues.emplace(value, var);
+        uniqueValueNodes.insert(uniqueValues, value, var);
         return;
     case 2:
-        uniqueValues.erase(value);
+        uniqueValueNodes.erase(uniqueValues, value);
         return;
     default:
         return;
     }
 }
 
-bool AllDifferentFamily::remove(int var, int value, std::vector<std::pair<int,int>>& varsToFix) {
-    if (!valToVar.at(value).erase(var)) return true;
+bool AllDifferentFamily::remove(int var, int value, std::pmr::vector<std::pair<int,int>>& varsToFix) {
+    if (!varNodes.erase(valToVar.at(value), var)) return true;
 
     switch (valToVar.at(value).size())
     {
     case 0:
         nbValPossible--;
-        uniqueValues.erase(value);
+        uniqueValueNodes.erase(uniqueValues, value);
         if (nbValPossible != nbVar()) return nbValPossible < nbVar();
         fillUniqueValues(varsToFix);
         return true;
     case 1:
     {
         int uniqueVar = *valToVar.at(value).begin();
-        uniqueValues.emplace(value, uniqueVar);
+        uniqueValueNodes.insert(uniqueValues, value, uniqueVar);
         if (nbValPossible==nbVar()) varsToFix.push_back(std::make_pair(uniqueVar,value));
         return true;
     }
@@ -60,14 +60,14 @@ bool AllDifferentFamily::remove(int var, int value, std::vector<std::pair<int,in
     }
 }
 
-bool AllDifferentFamily::init(std::vector<std::pair<int,int>>& varsToFix) const {
+bool AllDifferentFamily::init(std::pmr::vector<std::pair<int,int>>& varsToFix) const {
     if (nbVar() > nbVal()) return false;
     if (nbVar() < nbVal()) return true;
     fillUniqueValues(varsToFix);
     return true;
 }
 
-void AllDifferentFamily::fillUniqueValues(std::vector<std::pair<int,int>>& varsToFix) const {
+void AllDifferentFamily::fillUniqueValues(std::pmr::vector<std::pair<int,int>>& varsToFix) const {
     for (auto [value, var] : uniqueValues) {
         varsToFix.push_back(std::make_pair(var,value));
     }
@@ -4,6 +4,8 @@
 #include<unordered_set>
 #include<unordered_map>
 #include<vector>
+#include<memory_resource>
+#include "nodepool.h"
 
 class AllDifferentFamily {
 
@@ -12,6 +14,9 @@ private:
     std::unordered_map<int,std::unordered_set<int>> valToVar;
     // Values such that there is exactly one variable that can take this value
     std::unordered_map<int,int> uniqueValues;
+    // Nodes of the entries removed, reused when they are added back on backtrack
+    NodePool<std::unordered_set<int>> varNodes;
+    NodePool<std::unordered_map<int,int>> uniqueValueNodes;
 
     unsigned int nbValPossible;
 
@@ -21,12 +26,12 @@ public:
     unsigned int nbVar() const{return (unsigned int)(variables.size());}
     unsigned int nbVal() const{return (unsigned int)(valToVar.size());}
 
-    bool remove(int var, int val, std::vector<std::pair<int,int>>& varsToFix);
+    bool remove(int var, int val, std::pmr::vector<std::pair<int,int>>& varsToFix);
     void add(int var, int val);
 
-    bool init(std::vector<std::pair<int,int>>& varsToFix) const;
+    bool init(std::pmr::vector<std::pair<int,int>>& varsToFix) const;
 
-    void fillUniqueValues(std::vector<std::pair<int,int>>& varsToFix) const;
+    void fillUniqueValues(std::pmr::vector<std::pair<int,int>>& varsToFix) const;
 
     bool isCoherent(const std::unordered_map<int,std::unordered_set<int>>& domains) const;
 
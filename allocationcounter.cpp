@@ -0,0 +1,25 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocationcounter.h"
+
+// Every heap allocation of the process goes through this counter, so a
+// propagator that builds a temporary vector shows up in the allocation counts
+static std::atomic<unsigned long> nbAllocations{0};
+
+unsigned long getNbAllocations() {
+    return nbAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    nbAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (void* ptr = std::malloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {return operator new(size);}
+void operator delete(void* ptr) noexcept {std::free(ptr);}
+void operator delete[](void* ptr) noexcept {std::free(ptr);}
+void operator delete(void* ptr, std::size_t) noexcept {std::free(ptr);}
+void operator delete[](void* ptr, std::size_t) noexcept {std::free(ptr);}
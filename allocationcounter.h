@@ -0,0 +1,8 @@
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+// Heap allocations of the process so far, counted by the global operator new of
+// allocationcounter.cpp. It is linked into the benchmark and into debug builds.
+unsigned long getNbAllocations();
+
+#endif
@@ -0,0 +1,33 @@
+#include <cstdint>
+
+#include "arena.h"
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    while (block < blocks.size()) {
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(blocks[block].data.get());
+        std::size_t start = std::size_t(((base + offset + alignment - 1) & ~std::uintptr_t(alignment - 1)) - base);
+        if (start + bytes <= blocks[block].size) {
+            offset = start + bytes;
+            return blocks[block].data.get() + start;
+        }
+        // The end of the block stays unused until a release
+        block++;
+        offset = 0;
+    }
+    std::size_t size = (bytes + alignment > BLOCK_SIZE) ? bytes + alignment : BLOCK_SIZE;
+    blocks.push_back(Block{std::make_unique<std::byte[]>(size), size});
+    return do_allocate(bytes, alignment);
+}
+
+void Arena::do_deallocate(void* ptr, std::size_t bytes, std::size_t) {
+    if (block == blocks.size()) return;
+    std::byte* begin = blocks[block].data.get();
+    std::byte* freed = static_cast<std::byte*>(ptr);
+    if (freed >= begin && freed + bytes == begin + offset) offset = std::size_t(freed - begin);
+}
+
+std::size_t Arena::capacity() const {
+    std::size_t total = 0;
+    for (const Block& b : blocks) total += b.size;
+    return total;
+}
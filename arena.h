@@ -0,0 +1,53 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for the temporaries of a search, to be used by std::pmr containers.
+// Memory comes from blocks which are kept once allocated. Freeing the last allocation
+// gives it back at once, other frees wait for a release() to a mark taken before the
+// allocation. Containers must be destroyed before a release which covers them.
+class Arena : public std::pmr::memory_resource {
+
+public:
+    struct Mark {
+        std::size_t block;
+        std::size_t offset;
+    };
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+    std::vector<Block> blocks;
+    // Next free byte
+    std::size_t block=0;
+    std::size_t offset=0;
+
+    static const std::size_t BLOCK_SIZE = std::size_t(1) << 16;
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment);
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment);
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept {return this == &other;}
+
+public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    Mark mark() const{return Mark{block, offset};}
+    // Free everything allocated since mark was taken
+    void release(Mark mark) {
+        block = mark.block;
+        offset = mark.offset;
+    }
+    // Bytes held in blocks, whether used or not
+    std::size_t capacity() const;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <stdexcept>
+
+#include "batch.h"
+
+// Inverse of the sudoku reader character encoding
+static char sudokuCellChar(int value) {
+    if (value <= 9) return char('0' + value);
+    if (value <= 35) return char('A' + value - 10);
+    return char('a' + value - 36);
+}
+
+BatchSolver::BatchSolver(const std::string& _problemType, const std::string& _model, const std::vector<std::string>& _parameters, unsigned int _nbThreads) :
+    model{_model}, parameters{_parameters}, nbThreads{std::max(_nbThreads, 1u)} {
+    if (_problemType == "sudoku") problemType = Problem::Sudoku;
+    else if (_problemType == "blocked_queens") problemType = Problem::BlockedQueens;
+    else throw std::logic_error("Batch solving is only available for sudoku and blocked_queens");
+}
+
+void BatchSolver::compile(int _size) {
+    size = _size;
+    csp.setModel(model);
+    csp.setProblemType(problemType);
+    if (problemType == Problem::Sudoku) {
+        SudokuProblem empty;
+        empty.n = (unsigned int)(size);
+        empty.grid.assign(empty.n, std::vector<int>(empty.n, 0));
+        csp.init(empty);
+    } else {
+        BlockedQueenProblem empty;
+        empty.nb_queens = size;
+        csp.init(empty);
+    }
+    for (unsigned int t=0; t<nbThreads; t++) {
+        solvers.push_back(std::make_unique<Solver>(csp, parameters, false));
+        solvers.back()->setQuiet(true);
+        rootConsistent = solvers.back()->initSolve();
+    }
+}
+
+BatchSolver::Instance BatchSolver::readInstance(std::string_view line) {
+    Instance instance;
+    if (problemType == Problem::Sudoku) {
+        SudokuProblem problem = ProblemReader::readSudokuLine(line);
+        if (size == 0) compile(int(problem.n));
+        if (int(problem.n) != size) throw std::logic_error("Batch sudokus must all have side " + std::to_string(size));
+        std::string_view trimmed = line.substr(0, line.find_last_not_of(" \t\r") + 1);
+        instance.charEncoded = (trimmed.find_first_of(" \t", trimmed.find_first_not_of(" \t")) == std::string_view::npos);
+        for (int i=0; i<size; i++) {
+            for (int j=0; j<size; j++) {
+                int given = problem.grid[(unsigned int)(i)][(unsigned int)(j)];
+                if (given == 0) continue;
+                for (int value=1; value<=size; value++) {
+                    if (value != given) instance.removals.push_back(std::make_pair(size*i+j, value));
+                }
+            }
+        }
+    } else {
+        BlockedQueenProblem problem = ProblemReader::readBlockedQueenLine(line);
+        if (size == 0) compile(problem.nb_queens);
+        if (problem.nb_queens != size) throw std::logic_error("Batch blocked queens must all have " + std::to_string(size) + " queens");
+        for (auto [i,j] : problem.blockedSquares) {
+            if (i < 0 || i >= size || j < 0 || j >= size) throw std::logic_error("Blocked square out of the board");
+            instance.removals.push_back(std::make_pair(i, j));
+        }
+    }
+    return instance;
+}
+
+void BatchSolver::solveChunk(std::vector<Instance>& chunk) {
+    if (chunk.empty() || !rootConsistent) return;
+    std::atomic<std::size_t> next{0};
+    auto work = [&chunk, &next](Solver& solver) {
+        for (std::size_t idx=next++; idx<chunk.size(); idx=next++) {
+            Instance& instance = chunk[idx];
+            instance.solved = solver.solveWithRemovals(instance.removals);
+            if (instance.solved) instance.solution = solver.getSolutions().front();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t t=1; t<std::min(solvers.size(), chunk.size()); t++) {
+        threads.emplace_back(work, std::ref(*solvers[t]));
+    }
+    work(*solvers[0]);
+    for (auto& t : threads) t.join();
+}
+
+void BatchSolver::writeSolution(const Instance& instance, std::ostream& output) const {
+    if (!instance.solved) {
+        output << "infeasible\n";
+        return;
+    }
+    assert(csp.feasible(instance.solution));
+    for (auto [var,value] : instance.removals) assert(instance.solution.at(var) != value);
+    for (int var=0; var<int(instance.solution.size()); var++) {
+        int value = instance.solution.at(var);
+        if (instance.charEncoded) output << sudokuCellChar(value);
+        else output << (var > 0 ? " " : "") << value;
+    }
+    output << "\n";
+}
+
+void BatchSolver::run(std::istream& input, std::ostream& output) {
+    std::vector<Instance> chunk;
+    std::string line;
+    bool hasLine = true;
+    while (hasLine) {
+        chunk.clear();
+        while (chunk.size() < CHUNK_SIZE && (hasLine = bool(std::getline(input, line)))) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            chunk.push_back(readInstance(line));
+        }
+        solveChunk(chunk);
+        for (const Instance& instance : chunk) {
+            nbInstances++;
+            if (instance.solved) nbSolved++;
+            writeSolution(instance, output);
+        }
+        output.flush();
+    }
+}
+
+unsigned long BatchSolver::getNbNodesExplored() const{
+    unsigned long nbNodes = 0;
+    for (const auto& solver : solvers) nbNodes += solver->getNbNodesExplored();
+    return nbNodes;
+}
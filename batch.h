@@ -0,0 +1,62 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "solver.h"
+
+// Solve a stream of instances sharing the same structure, one per line: sudoku
+// grids of the same side or blocked queens with the same number of queens.
+// The model is built once from the empty instance, each thread copies it into
+// its own solver, and an instance only removes values at a trail level which
+// is backtracked once it is solved.
+class BatchSolver {
+
+private:
+    struct Instance {
+        std::vector<std::pair<int,int>> removals;
+        // Sudoku grid given with one character per cell, answered the same way
+        bool charEncoded=false;
+        bool solved=false;
+        std::unordered_map<int,int> solution;
+    };
+
+    // Instances read from the stream before being solved in parallel
+    static const std::size_t CHUNK_SIZE = 1024;
+
+    Problem problemType;
+    std::string model;
+    std::vector<std::string> parameters;
+    unsigned int nbThreads;
+
+    // Sudoku side or number of queens of the built model, 0 before the first instance
+    int size=0;
+    CSP csp;
+    std::vector<std::unique_ptr<Solver>> solvers;
+    bool rootConsistent=true;
+
+    unsigned long nbInstances=0;
+    unsigned long nbSolved=0;
+
+    // Build the model and the solvers for instances of this size
+    void compile(int _size);
+    Instance readInstance(std::string_view line);
+    void solveChunk(std::vector<Instance>& chunk);
+    void writeSolution(const Instance& instance, std::ostream& output) const;
+
+public:
+    // problemType is "sudoku" or "blocked_queens", parameters those of the Solver
+    BatchSolver(const std::string& _problemType, const std::string& _model, const std::vector<std::string>& _parameters, unsigned int _nbThreads);
+
+    // Write one line per instance of input, in the same order: the solution, or "infeasible"
+    void run(std::istream& input, std::ostream& output);
+
+    unsigned long getNbInstances() const{return nbInstances;}
+    unsigned long getNbSolved() const{return nbSolved;}
+    unsigned long getNbNodesExplored() const;
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+
+#include "solver.h"
+#include "allocationcounter.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    std::string name;
+    std::string instance;
+    unsigned long calls=0;
+    double ns=0.;
+    unsigned long revisions=0;
+    unsigned long removals=0;
+    unsigned long allocations=0;
+};
+
+// Mute the solver logs while it builds its root state
+class Silence {
+private:
+    std::ostringstream sink;
+    std::streambuf* old;
+public:
+    Silence() : old{std::cout.rdbuf(sink.rdbuf())} {}
+    ~Silence() {std::cout.rdbuf(old);}
+};
+
+static double elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+static std::vector<std::string> parametersFor(const std::string& solveMethod, const std::string& valueChooser="copy") {
+    return {solveMethod, solveMethod, "smallest", valueChooser, "-1", "42", "1", "0"};
+}
+
+static CSP makeQueens(int n) {
+    CSP csp;
+    csp.init(QueenProblem{n});
+    return csp;
+}
+
+// Random binary CSP: each pair of variables is constrained with probability density,
+// each constraint forbids a fraction tightness of the value pairs
+static CSP makeRandom(int nbVar, int domainSize, double density, double tightness, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unif(0., 1.);
+    CSP csp;
+    for (int var=0; var<nbVar; var++) {
+        csp.addVariable(var);
+        csp.addVariableRange(var, 0, domainSize);
+    }
+    for (int x=0; x<nbVar; x++) {
+        for (int y=x+1; y<nbVar; y++) {
+            if (unif(rng) >= density) continue;
+            csp.addConstraint(x, y);
+            for (int a=0; a<domainSize; a++) {
+                for (int b=0; b<domainSize; b++) {
+                    if (unif(rng) >= tightness) csp.addConstraintValuePair(x, y, a, b);
+                }
+            }
+        }
+    }
+    return csp;
+}
+
+static std::string randomLabel(int nbVar, int domainSize, double tightness) {
+    std::ostringstream label;
+    label << "random n=" << nbVar << " d=" << domainSize << " t=" << tightness;
+    return label.str();
+}
+
+// Time one propagator call per trial on a fixed root state: branch on a random
+// (var, value), run the propagator, then backtrack to the root state. The trials are
+// run a first time untimed, so that the caches of the solver are warm.
+template<typename Propagate>
+static BenchResult benchPropagator(const std::string& name, const std::string& instance, Solver& solver, unsigned int trials, Propagate propagate) {
+    BenchResult result{name, instance};
+    std::vector<int> variables(solver.getProblem().getVariables().begin(), solver.getProblem().getVariables().end());
+    std::sort(variables.begin(), variables.end());
+
+    for (unsigned int pass=0; pass<2; pass++) {
+        result = BenchResult{name, instance};
+        std::mt19937 rng(42);
+        for (unsigned int trial=0; trial<trials; trial++) {
+            int var = variables[rng() % variables.size()];
+            if (solver.getProblem().getDomainSize(var) <= 1) continue;
+            std::vector<int> values = solver.getProblem().getDomainCopy(var);
+            int value = values[rng() % values.size()];
+            std::unordered_set<int> domain = solver.getProblem().getDomain(var);
+            solver.branchOnVar(var, value);
+
+            unsigned long revisions = solver.getNbRevisions();
+            unsigned long removals = solver.getNbRemovals();
+            unsigned long allocations = getNbAllocations();
+            Clock::time_point start = Clock::now();
+            propagate(var, value, domain);
+            Clock::time_point end = Clock::now();
+            result.allocations += getNbAllocations() - allocations;
+            result.ns += elapsedNs(start, end);
+            result.revisions += solver.getNbRevisions() - revisions;
+            result.removals += solver.getNbRemovals() - removals;
+            result.calls++;
+
+            solver.backtrack();
+            solver.unbranchOnVar(var, domain);
+        }
+    }
+    return result;
+}
+
+static BenchResult benchForwardChecking(const CSP& csp, const std::string& instance, unsigned int trials) {
+    Solver solver(csp, parametersFor("FC"), false);
+    {
+        Silence silence;
+        if (!solver.initSolve()) throw std::logic_error("Inconsistent benchmark instance");
+    }
+    return benchPropagator("forwardChecking", instance, solver, trials, [&solver](int var, int value, const std::unordered_set<int>&) {
+        solver.forwardChecking(var, value);
+    });
+}
+
+static BenchResult benchAC3(const CSP& csp, const std::string& instance, unsigned int trials) {
+    Solver solver(csp, parametersFor("AC3"), false);
+    {
+        Silence silence;
+        if (!solver.initSolve()) throw std::logic_error("Inconsistent benchmark instance");
+    }
+    return benchPropagator("AC3", instance, solver, trials, [&solver](int var, int, const std::unordered_set<int>&) {
+        solver.initAC3Solve(var);
+        solver.AC3();
+    });
+}
+
+static BenchResult benchAC4(const CSP& csp, const std::string& instance, unsigned int trials) {
+    Solver solver(csp, parametersFor("AC4"), false);
+    {
+        Silence silence;
+        if (!solver.initSolve()) throw std::logic_error("Inconsistent benchmark instance");
+    }
+    return benchPropagator("AC4", instance, solver, trials, [&solver](int var, int value, const std::unordered_set<int>& domain) {
+        solver.initAC4Solve(var, value, domain);
+        solver.AC4();
+    });
+}
+
+// With lcv, the values are scored against the domains of all the neighbors first
+static BenchResult benchChooseValue(const CSP& csp, const std::string& instance, const std::string& valueChooser, unsigned int trials) {
+    Solver solver(csp, parametersFor("FC", valueChooser), false);
+    {
+        Silence silence;
+        if (!solver.initSolve()) throw std::logic_error("Inconsistent benchmark instance");
+    }
+    BenchResult result{"chooseValue(" + valueChooser + ")", instance};
+    int n = int(csp.nbVar());
+    // The search reuses the buffer of its decisions, which a first untimed call grows
+    std::vector<int> values;
+    solver.chooseValue(0, values);
+    for (unsigned int trial=0; trial<trials; trial++) {
+        unsigned long allocations = getNbAllocations();
+        Clock::time_point start = Clock::now();
+        solver.chooseValue(int(trial) % n, values);
+        Clock::time_point end = Clock::now();
+        result.allocations += getNbAllocations() - allocations;
+        result.ns += elapsedNs(start, end);
+        result.calls++;
+    }
+    return result;
+}
+
+// Only the first value of each decision, the search tries the others on failures
+static BenchResult benchFirstValue(const CSP& csp, const std::string& instance, const std::string& name, const ValueChooser& chooser, unsigned int trials) {
+    BenchResult result{"firstValue(" + name + ")", instance};
+    int n = int(csp.nbVar());
+    ValueCursor cursor;
+    long long sum = 0;
+    for (unsigned int trial=0; trial<trials; trial++) {
+        unsigned long allocations = getNbAllocations();
+        Clock::time_point start = Clock::now();
+        int value;
+        chooser.start(int(trial) % n, csp.getDomain(int(trial) % n), cursor);
+        if (chooser.next(cursor, value)) sum += value;
+        Clock::time_point end = Clock::now();
+        result.allocations += getNbAllocations() - allocations;
+        result.ns += elapsedNs(start, end);
+        result.calls++;
+    }
+    if (sum < 0) std::cout << sum << std::endl;
+    return result;
+}
+
+// A branch as the search makes it, without propagation: the domain of the variable is
+// swapped out, the variable set, then the branch undone and the domain given back
+static BenchResult benchSetVar(const CSP& csp, const std::string& instance, unsigned int trials) {
+    Solver solver(csp, parametersFor("FC"), false);
+    {
+        Silence silence;
+        if (!solver.initSolve()) throw std::logic_error("Inconsistent benchmark instance");
+    }
+    BenchResult result{"setVar", instance};
+    std::mt19937 rng(42);
+    std::vector<int> variables(csp.getVariables().begin(), csp.getVariables().end());
+    std::sort(variables.begin(), variables.end());
+    std::unordered_set<int> domain;
+    for (unsigned int trial=0; trial<trials; trial++) {
+        int var = variables[trial % variables.size()];
+        std::vector<int> values = solver.getProblem().getDomainCopy(var);
+        int value = values[rng() % values.size()];
+
+        unsigned long allocations = getNbAllocations();
+        Clock::time_point start = Clock::now();
+        solver.unbranchOnVar(var, domain);
+        solver.branchOnVar(var, value);
+        solver.backtrack();
+        solver.unbranchOnVar(var, domain);
+        Clock::time_point end = Clock::now();
+        result.allocations += getNbAllocations() - allocations;
+        result.ns += elapsedNs(start, end);
+        result.calls++;
+    }
+    return result;
+}
+
+// Remove one random value per variable of an all different family over n
+// variables with domain [0,n), then add them back
+static std::vector<BenchResult> benchAllDifferent(int n, unsigned int rounds) {
+    std::unordered_map<int,std::unordered_set<int>> domains;
+    std::vector<int> variables;
+    for (int var=0; var<n; var++) {
+        variables.push_back(var);
+        domains.emplace(var, std::unordered_set<int>());
+        for (int value=0; value<n; value++) domains.at(var).emplace(value);
+    }
+    AllDifferentFamily family(variables, domains);
+    std::string instance = "alldiff n=" + std::to_string(n);
+    BenchResult removeResult{"AllDifferentFamily::remove", instance};
+    BenchResult addResult{"AllDifferentFamily::add", instance};
+
+    std::mt19937 rng(42);
+    std::pmr::vector<std::pair<int,int>> varsToFix;
+    varsToFix.reserve(size_t(4*n));
+    std::vector<int> removedValues((size_t)(n));
+    for (unsigned int round=0; round<rounds; round++) {
+        for (int var=0; var<n; var++) removedValues[(size_t)(var)] = int(rng() % (unsigned int)(n));
+
+        unsigned long allocations = getNbAllocations();
+        Clock::time_point start = Clock::now();
+        for (int var=0; var<n; var++) {
+            varsToFix.clear();
+            family.remove(var, removedValues[(size_t)(var)], varsToFix);
+        }
+        Clock::time_point end = Clock::now();
+        removeResult.allocations += getNbAllocations() - allocations;
+        removeResult.ns += elapsedNs(start, end);
+        removeResult.calls += (unsigned long)(n);
+        removeResult.removals += (unsigned long)(n);
+
+        allocations = getNbAllocations();
+        start = Clock::now();
+        for (int var=0; var<n; var++) {
+            family.add(var, removedValues[(size_t)(var)]);
+        }
+        end = Clock::now();
+        addResult.allocations += getNbAllocations() - allocations;
+        addResult.ns += elapsedNs(start, end);
+        addResult.calls += (unsigned long)(n);
+    }
+    return {removeResult, addResult};
+}
+
+static void displayHeader() {
+    std::cout << std::left << std::setw(28) << "benchmark" << std::setw(30) << "instance" << std::right
+              << std::setw(8) << "calls" << std::setw(14) << "ns/call" << std::setw(14) << "ns/revision"
+              << std::setw(14) << "ns/removal" << std::setw(14) << "allocs/call" << std::endl;
+    std::cout << std::string(122, '-') << std::endl;
+}
+
+static void display(const BenchResult& result) {
+    auto perUnit = [&result](unsigned long units) {
+        std::ostringstream ss;
+        if (units == 0) ss << "-";
+        else ss << std::fixed << std::setprecision(1) << result.ns / double(units);
+        return ss.str();
+    };
+    std::ostringstream allocs;
+    allocs << std::fixed << std::setprecision(2) << (result.calls ? double(result.allocations) / double(result.calls) : 0.);
+    std::cout << std::left << std::setw(28) << result.name << std::setw(30) << result.instance << std::right
+              << std::setw(8) << result.calls << std::setw(14) << perUnit(result.calls)
+              << std::setw(14) << perUnit(result.revisions) << std::setw(14) << perUnit(result.removals)
+              << std::setw(14) << allocs.str() << std::endl;
+}
+
+// Display a result which should not allocate once warm, false if it does
+static bool displayAllocationFree(const BenchResult& result) {
+    display(result);
+    if (result.allocations * 10 <= result.calls) return true;
+    std::cout << result.name << " allocates on " << result.instance << std::endl;
+    return false;
+}
+
+int main(int argc, char** argv) {
+    // Usage: bench [queensSize...]
+    std::vector<int> queensSizes = {100, 500, 1000};
+    if (argc > 1) {
+        queensSizes.clear();
+        for (int i=1; i<argc; i++) queensSizes.push_back(std::stoi(argv[i]));
+    }
+
+    // The benchmark fails if a result that should not allocate does
+    bool allocationFree = true;
+    displayHeader();
+    for (int n : queensSizes) {
+        CSP queens = makeQueens(n);
+        std::string instance = "queens n=" + std::to_string(n);
+        allocationFree &= displayAllocationFree(benchForwardChecking(queens, instance, 200));
+        allocationFree &= displayAllocationFree(benchSetVar(queens, instance, 1000));
+        allocationFree &= displayAllocationFree(benchChooseValue(queens, instance, "copy", 1000));
+        allocationFree &= displayAllocationFree(benchChooseValue(queens, instance, "smallest", 1000));
+        allocationFree &= displayAllocationFree(benchChooseValue(queens, instance, "random", 1000));
+        allocationFree &= displayAllocationFree(benchChooseValue(queens, instance, "lcv", 20));
+        allocationFree &= displayAllocationFree(benchFirstValue(queens, instance, "smallest", SmallestValueChooser(), 1000));
+        allocationFree &= displayAllocationFree(benchFirstValue(queens, instance, "random", RandomValueChooser(), 1000));
+    }
+
+    for (int n : {20, 50}) {
+        allocationFree &= displayAllocationFree(benchAC3(makeQueens(n), "queens n=" + std::to_string(n), 50));
+    }
+
+    for (double tightness : {0.2, 0.4, 0.6}) {
+        const int nbVar = 60;
+        const int domainSize = 12;
+        CSP random = makeRandom(nbVar, domainSize, 0.2, tightness, 42);
+        std::string instance = randomLabel(nbVar, domainSize, tightness);
+        allocationFree &= displayAllocationFree(benchForwardChecking(random, instance, 500));
+        allocationFree &= displayAllocationFree(benchChooseValue(random, instance, "lcv", 500));
+        allocationFree &= displayAllocationFree(benchAC3(random, instance, 200));
+        allocationFree &= displayAllocationFree(benchAC4(random, instance, 200));
+    }
+
+    for (int n : queensSizes) {
+        std::vector<BenchResult> results = benchAllDifferent(n, 20);
+        allocationFree &= displayAllocationFree(results[0]);
+        display(results[1]);
+    }
+    return allocationFree ? 0 : 1;
+}
@@ -1,58 +1,197 @@
 #include<iostream>
+#include <algorithm>
 #include <cassert>
+#include <tuple>
 
 #include "constraint.h"
 
 
-ExtensiveConstraint::ExtensiveConstraint(int _x, int _y, const std::vector<std::pair<int,int>>& pairs): Constraint(_x,_y) {
-    for (const auto& [a,b] : pairs) {
-        addPair(a,b);
+void Constraint::getUnsupported(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy, std::vector<int>& unsupported) const {
+    for (int a : Dx) {
+        bool hasSupport = false;
+        for (int b : Dy) {
+            if (feasible(a,b)) {
+                hasSupport = true;
+                break;
+            }
+        }
+        if (!hasSupport) unsupported.push_back(a);
     }
 }
 
-void ExtensiveConstraint::addPair(int a, int b) {
-    if (list.count(a)==0)
-        list.emplace(a,std::unordered_set<int>());
-    list.at(a).emplace(b);
+ExtensiveRelation::ExtensiveRelation(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) {
+    sides[0].values.assign(Dx.begin(), Dx.end());
+    sides[1].values.assign(Dy.begin(), Dy.end());
+    for (Side& s : sides) {
+        std::sort(s.values.begin(), s.values.end());
+        for (unsigned int i=0; i<s.values.size(); i++) {
+            s.index.emplace(s.values[i], i);
+        }
+        s.rowSize.assign(s.values.size(), 0);
+    }
+    for (int t=0; t<2; t++) {
+        sides[t].words = (sides[1-t].values.size() + 63) / 64;
+        sides[t].rows.assign(sides[t].values.size() * sides[t].words, 0);
+    }
 }
 
-void ExtensiveConstraint::removePair(int a, int b) {
-    if (list.count(a)==0) return;
-    list.at(a).erase(b);
+ExtensiveRelation::ExtensiveRelation(std::vector<int> valuesX, std::vector<int> valuesY, std::vector<uint64_t> rowsX, std::vector<uint64_t> rowsY) {
+    sides[0].values = std::move(valuesX);
+    sides[1].values = std::move(valuesY);
+    sides[0].rows = std::move(rowsX);
+    sides[1].rows = std::move(rowsY);
+    for (int t=0; t<2; t++) {
+        Side& s = sides[t];
+        if (!std::is_sorted(s.values.begin(), s.values.end())) throw std::logic_error("Relation values are not sorted");
+        s.words = (sides[1-t].values.size() + 63) / 64;
+        if (s.rows.size() != s.values.size() * s.words) throw std::logic_error("Relation rows do not match its values");
+        for (unsigned int i=0; i<s.values.size(); i++) {
+            if (!s.index.emplace(s.values[i], i).second) throw std::logic_error("Relation values are repeated");
+            unsigned int count = 0;
+            for (std::size_t w=0; w<s.words; w++) count += (unsigned int)(__builtin_popcountll(s.rows[i * s.words + w]));
+            s.rowSize.push_back(count);
+        }
+    }
 }
 
-std::vector<std::pair<int,int>> ExtensiveConstraint::getUselessPairs(const std::unordered_set<int>& Dx) const{
-    std::vector<std::pair<int,int>> uselessPairs;
-    for (const auto& [a,bSet]:list) {
-        if (!Dx.count(a)) {
-            for (int b : bSet) {
-                uselessPairs.push_back(std::make_pair(a,b));
-            }
+std::size_t ExtensiveRelation::estimateSize(std::size_t sizeX, std::size_t sizeY) {
+    // both bit matrices, row sizes and value indices
+    std::size_t bits = 8 * (sizeX * ((sizeY + 63) / 64) + sizeY * ((sizeX + 63) / 64));
+    const std::size_t bytesPerValue = 48;
+    return sizeof(ExtensiveRelation) + bits + (sizeX + sizeY) * bytesPerValue;
+}
+
+void ExtensiveRelation::addValue(int side, int value) {
+    std::unordered_set<int> domains[2];
+    for (int t=0; t<2; t++) domains[t].insert(sides[t].values.begin(), sides[t].values.end());
+    domains[side].insert(value);
+    ExtensiveRelation grown(domains[0], domains[1]);
+    std::vector<int> support;
+    for (int a : sides[0].values) {
+        support.clear();
+        getSupport(0, a, support);
+        for (int b : support) grown.addPair(0, a, b);
+    }
+    *this = std::move(grown);
+}
+
+void ExtensiveRelation::addPair(int side, int a, int b) {
+    // Values added to a domain after the constraint, rare enough to rebuild for each
+    if (!sides[side].index.count(a)) addValue(side, a);
+    if (!sides[1-side].index.count(b)) addValue(1-side, b);
+    Side& s = sides[side];
+    Side& o = sides[1-side];
+    auto ia = s.index.find(a);
+    auto ib = o.index.find(b);
+    uint64_t& word = s.rows[ia->second * s.words + ib->second / 64];
+    uint64_t mask = uint64_t(1) << (ib->second % 64);
+    if (word & mask) return;
+    word |= mask;
+    o.rows[ib->second * o.words + ia->second / 64] |= uint64_t(1) << (ia->second % 64);
+    s.rowSize[ia->second]++;
+    o.rowSize[ib->second]++;
+}
+
+void ExtensiveRelation::removePair(int side, int a, int b) {
+    Side& s = sides[side];
+    Side& o = sides[1-side];
+    auto ia = s.index.find(a);
+    auto ib = o.index.find(b);
+    if (ia == s.index.end() || ib == o.index.end()) return;
+    uint64_t& word = s.rows[ia->second * s.words + ib->second / 64];
+    uint64_t mask = uint64_t(1) << (ib->second % 64);
+    if (!(word & mask)) return;
+    word &= ~mask;
+    o.rows[ib->second * o.words + ia->second / 64] &= ~(uint64_t(1) << (ia->second % 64));
+    s.rowSize[ia->second]--;
+    o.rowSize[ib->second]--;
+}
+
+bool ExtensiveRelation::feasible(int side, int a, int b) const {
+    const Side& s = sides[side];
+    const Side& o = sides[1-side];
+    auto ia = s.index.find(a);
+    auto ib = o.index.find(b);
+    if (ia == s.index.end() || ib == o.index.end()) return false;
+    return (s.rows[ia->second * s.words + ib->second / 64] >> (ib->second % 64)) & 1;
+}
+
+std::size_t ExtensiveRelation::hash(int side) const {
+    // FNV-1a over the values of both sides and the rows read from side
+    std::size_t h = 14695981039346656037ULL;
+    auto mix = [&h](uint64_t word) {
+        h ^= std::size_t(word);
+        h *= 1099511628211ULL;
+    };
+    for (int value : sides[side].values) mix(uint64_t(value));
+    mix(uint64_t(-1));
+    for (int value : sides[1-side].values) mix(uint64_t(value));
+    for (uint64_t word : sides[side].rows) mix(word);
+    return h;
+}
+
+bool ExtensiveRelation::equals(int side, const ExtensiveRelation& other, int otherSide) const {
+    // the rows of one side determine the rows of the other
+    return sides[side].values == other.sides[otherSide].values
+        && sides[1-side].values == other.sides[1-otherSide].values
+        && sides[side].rows == other.sides[otherSide].rows;
+}
+
+void ExtensiveRelation::display(int side) const {
+    std::vector<int> support;
+    for (int a : sides[side].values) {
+        support.clear();
+        getSupport(side, a, support);
+        for (int b : support) {
+            std::cout << "(" << a << "," << b << "),";
         }
     }
-    return uselessPairs;
 }
 
-std::vector<int> ExtensiveConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy) const{
-    std::vector<int> forbiddenValues;
+void ExtensiveRelation::getSupport(int side, int a, std::vector<int>& support) const {
+    const Side& s = sides[side];
+    const Side& o = sides[1-side];
+    auto ia = s.index.find(a);
+    if (ia == s.index.end()) return;
+    const uint64_t* row = &s.rows[ia->second * s.words];
+    for (std::size_t w=0; w<s.words; w++) {
+        uint64_t word = row[w];
+        while (word) {
+            support.push_back(o.values[64*w + std::size_t(__builtin_ctzll(word))]);
+            word &= word - 1;
+        }
+    }
+}
+
+size_t ExtensiveRelation::getSupportSize(int side, int a) const {
+    const Side& s = sides[side];
+    auto ia = s.index.find(a);
+    return ia == s.index.end() ? 0 : s.rowSize[ia->second];
+}
+
+int ExtensiveRelation::getIndex(int side, int a) const {
+    auto ia = sides[side].index.find(a);
+    return ia == sides[side].index.end() ? -1 : int(ia->second);
+}
+
+void ExtensiveConstraint::intern(RelationPool& pool) {
+    std::tie(relation, side) = pool.intern(relation, side);
+}
+
+void ExtensiveConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
     for (int b : Dy) {
-        if (!feasible(a,b)) forbiddenValues.push_back(b);
+        if (!feasible(a,b)) forbidden.push_back(b);
     }
-    return forbiddenValues;
 }
 
 void ExtensiveConstraint::display() const {
     std::cout << x << "," << y << ":";
-    for (const auto& [a,bSet] : list) {
-        for (int b : bSet) {
-            std::cout << "(" << a << "," << b << "),";
-        }
-    }
+    relation->display(side);
     std::cout << std::endl;
 }
 
-std::unique_ptr<Constraint> IntensiveConstraint::extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) {
-    ExtensiveConstraint* constraint = new ExtensiveConstraint(x,y);
+std::unique_ptr<Constraint> IntensiveConstraint::extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const {
+    ExtensiveConstraint* constraint = new ExtensiveConstraint(x,y,Dx,Dy);
     for (int a : Dx) {
         for (int b : Dy) {
             if (feasible(a,b)) constraint->addPair(a,b);
@@ -61,31 +200,29 @@ std::unique_ptr<Constraint> IntensiveConstraint::extensify(const std::unordered_
     return std::unique_ptr<ExtensiveConstraint> (constraint);
 }
 
-std::vector<int> IntensiveConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy) const{
-    if (forbiddenValuesFunction.has_value()) return getForbiddenValuesSmart(a, Dy);
-    return getForbiddenValuesDefault(a, Dy);
+void IntensiveConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
+    if (relation->forbiddenValuesFunction.has_value()) getForbiddenValuesSmart(a, Dy, forbidden);
+    else getForbiddenValuesDefault(a, Dy, forbidden);
 }
 
-std::vector<int> IntensiveConstraint::getForbiddenValuesDefault(int a, const std::unordered_set<int>& Dy) const{
-    std::vector<int> forbiddenValues;
+void IntensiveConstraint::getForbiddenValuesDefault(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
     for (int b : Dy) {
-        if (!feasible(a,b)) forbiddenValues.push_back(b);
+        if (!feasible(a,b)) forbidden.push_back(b);
     }
-    return forbiddenValues;
 }
 
-std::vector<int> IntensiveConstraint::getForbiddenValuesSmart(int a, const std::unordered_set<int>& Dy) const{
-    assert(forbiddenValuesFunction.has_value());
-    std::vector<int> forbiddenValues;
-    for (int b : (*forbiddenValuesFunction)(a)) {
-        if (Dy.count(b)) forbiddenValues.push_back(b);
-    }
-    return forbiddenValues;
+void IntensiveConstraint::getForbiddenValuesSmart(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
+    assert(relation->forbiddenValuesFunction.has_value());
+    assert(relation->symmetric);
+    // The values out of Dy are appended too, then dropped in place
+    std::size_t first = forbidden.size();
+    (*relation->forbiddenValuesFunction)(a, forbidden);
+    forbidden.erase(std::remove_if(forbidden.begin() + (std::ptrdiff_t)(first), forbidden.end(), [&Dy](int b) {return !Dy.count(b);}), forbidden.end());
 }
 
 
-std::unique_ptr<Constraint> DifferenceConstraint::extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) {
-    ExtensiveConstraint* constraint = new ExtensiveConstraint(x,y);
+std::unique_ptr<Constraint> DifferenceConstraint::extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const {
+    ExtensiveConstraint* constraint = new ExtensiveConstraint(x,y,Dx,Dy);
     for (int a : Dx) {
         for (int b : Dy) {
             if (a!=b) constraint->addPair(a,b);
@@ -94,7 +231,59 @@ std::unique_ptr<Constraint> DifferenceConstraint::extensify(const std::unordered
     return std::unique_ptr<ExtensiveConstraint> (constraint);
 }
 
-std::vector<int> DifferenceConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy) const{
-    if (Dy.count(a)) return {a};
-    return {};
-}
\ No newline at end of file
+LinePatterns::LinePatterns(const std::vector<std::vector<bool>>& patterns, std::size_t length) : nbPatterns{patterns.size()}, words{(patterns.size() + 63) / 64} {
+    filled.assign(length * words, 0);
+    for (std::size_t pattern=0; pattern<nbPatterns; pattern++) {
+        for (std::size_t cell=0; cell<length; cell++) {
+            if (patterns[pattern][cell]) filled[cell * words + pattern / 64] |= uint64_t(1) << (pattern % 64);
+        }
+    }
+}
+
+std::unique_ptr<Constraint> PatternConstraint::extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const {
+    ExtensiveConstraint* constraint = new ExtensiveConstraint(x,y,Dx,Dy);
+    for (int a : Dx) {
+        for (int b : Dy) {
+            if (feasible(a,b)) constraint->addPair(a,b);
+        }
+    }
+    return std::unique_ptr<ExtensiveConstraint> (constraint);
+}
+
+void PatternConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
+    bool isFilled = xPatterns->isFilled(a, xCell);
+    for (int b : Dy) {
+        if (yPatterns->isFilled(b, yCell) != isFilled) forbidden.push_back(b);
+    }
+}
+
+void PatternConstraint::getUnsupported(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy, std::vector<int>& unsupported) const {
+    // x=a only needs some pattern of Dy with the same value on the common cell
+    bool canFill = false;
+    bool canEmpty = false;
+    for (int b : Dy) {
+        if (yPatterns->isFilled(b, yCell)) canFill = true;
+        else canEmpty = true;
+        if (canFill && canEmpty) return;
+    }
+    for (int a : Dx) {
+        if (xPatterns->isFilled(a, xCell) ? !canFill : !canEmpty) unsupported.push_back(a);
+    }
+}
+
+void DifferenceConstraint::getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const{
+    if (Dy.count(a)) forbidden.push_back(a);
+}
+
+
+std::pair<std::shared_ptr<ExtensiveRelation>,int> RelationPool::intern(const std::shared_ptr<ExtensiveRelation>& relation, int side) {
+    auto range = relations.equal_range(relation->hash(side));
+    for (auto it=range.first; it!=range.second; it++) {
+        const auto& [pooled, pooledSide] = it->second;
+        if ((pooled == relation && pooledSide == side) || pooled->equals(pooledSide, *relation, side)) return it->second;
+    }
+    relations.emplace(relation->hash(0), std::make_pair(relation, 0));
+    if (!relation->equals(0, *relation, 1)) relations.emplace(relation->hash(1), std::make_pair(relation, 1));
+    nbRelations++;
+    return std::make_pair(relation, side);
+}
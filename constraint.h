@@ -9,7 +9,13 @@
 #include <stdexcept>
 #include <iostream>
 #include <optional>
+#include <cstdint>
 
+class RelationPool;
+
+// A constraint is a directional view x->y of a relation stored once per pair of
+// variables: the y->x constraint is its transpose and reads the same storage.
+// Identical relations of different pairs may also be shared through a RelationPool.
 class Constraint {
 
 public:
@@ -20,83 +26,165 @@ public:
     Constraint(){}
     Constraint(int _x, int _y, bool _isExtensive=false): x{_x}, y{_y}, isExtensive{_isExtensive} {}
     virtual ~Constraint(){}
-    
-    virtual std::unique_ptr<Constraint> clone()=0;
-    
-    virtual std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy)=0;
+
+    // Copy of the constraint, sharing its relation
+    virtual std::unique_ptr<Constraint> clone() const=0;
+    // View y->x of the same relation
+    virtual std::unique_ptr<Constraint> transpose() const=0;
+
+    virtual std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const=0;
+
+    // Replace the relation by an identical one of the pool, or add it to the pool
+    virtual void intern(RelationPool&) {}
+    // True if the relation is also referenced by other pairs of variables or by a pool,
+    // in which case it must be copied before adding or removing pairs
+    virtual bool isShared() const{return false;}
+    // Copy of the constraint owning its own copy of the relation
+    virtual std::unique_ptr<Constraint> detach() const{return clone();}
 
     virtual void addPair(int a, int b)=0;
     virtual void removePair(int a, int b)=0;
-    
+
     virtual bool feasible(int a, int b) const=0;
     virtual bool feasible(const std::unordered_map<int,int>& partSol) const=0;
 
-    // Get pairs where x=a is not in the domain Dx in input
-    virtual std::vector<std::pair<int,int>> getUselessPairs(const std::unordered_set<int>&) const=0;
+    // Append to forbidden the values b in Dy such that x=a => y!=b
+    virtual void getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const=0;
 
-    // return values b in Dy such that x=a => y!=b
-    virtual std::vector<int> getForbiddenValues(int a, const std::unordered_set<int>& Dy) const=0;
+    // Append to unsupported the values a in Dx without any b in Dy such that (a,b) is allowed
+    virtual void getUnsupported(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy, std::vector<int>& unsupported) const;
 
-    virtual const std::unordered_set<int>& getSupport(int a) const=0;
+    // Append to support the values b such that (a,b) is allowed
+    virtual void getSupport(int a, std::vector<int>& support) const=0;
     virtual size_t getSupportSize(int value) const=0;
 
+    // Extensive constraints: position of a among the x values of the relation, -1 if it is
+    // not one of them, and the number of these values
+    virtual int getValueIndex(int) const{throw std::logic_error("Constraint is not extensive");}
+    virtual std::size_t nbValues() const{throw std::logic_error("Constraint is not extensive");}
+
     virtual void display() const=0;
 };
 
+// Allowed pairs of a constraint as a bit matrix over the sorted x and y values,
+// stored together with its transpose so that both directions read whole rows.
+// A pair with a value outside the current ones grows the matrices to it.
+class ExtensiveRelation {
+
+private:
+    struct Side {
+        std::vector<int> values;
+        std::unordered_map<int,unsigned int> index;
+        std::size_t words=0; // words of a row, ie of a bitset over the other side values
+        std::vector<uint64_t> rows;
+        std::vector<unsigned int> rowSize;
+    };
+    Side sides[2];
+
+    // Rebuild the matrices with value added to side, keeping the allowed pairs
+    void addValue(int side, int value);
+
+public:
+    ExtensiveRelation(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy);
+    // Relation given by the sorted values of both sides and both bit matrices, as returned by
+    // getValues and getRows
+    ExtensiveRelation(std::vector<int> valuesX, std::vector<int> valuesY, std::vector<uint64_t> rowsX, std::vector<uint64_t> rowsY);
+
+    // Upper bound on the memory used for domains of these sizes
+    static std::size_t estimateSize(std::size_t sizeX, std::size_t sizeY);
+    std::size_t size() const{return estimateSize(sides[0].values.size(), sides[1].values.size());}
+
+    // Sorted values of a side, and its bit matrix: one row per value, over the other side values
+    const std::vector<int>& getValues(int side) const{return sides[side].values;}
+    const std::vector<uint64_t>& getRows(int side) const{return sides[side].rows;}
+
+    // Hash and equality of the views of the relations read from the given sides
+    std::size_t hash(int side) const;
+    bool equals(int side, const ExtensiveRelation& other, int otherSide) const;
+
+    // side 0 reads pairs (a,b) as (x,y), side 1 as (y,x)
+    void addPair(int side, int a, int b);
+    void removePair(int side, int a, int b);
+    bool feasible(int side, int a, int b) const;
+    void getSupport(int side, int a, std::vector<int>& support) const;
+    size_t getSupportSize(int side, int a) const;
+    // Position of a in getValues(side), -1 if absent
+    int getIndex(int side, int a) const;
+
+    void display(int side) const;
+};
+
 class ExtensiveConstraint : public Constraint {
 
 protected:
-    std::unordered_map<int, std::unordered_set<int>> list;
+    std::shared_ptr<ExtensiveRelation> relation;
+    int side;
 
 public:
-    ExtensiveConstraint(int _x, int _y): Constraint(_x, _y, true) {};
-    ExtensiveConstraint(int _x, int _y, const std::vector<std::pair<int,int>>& pairs);
+    ExtensiveConstraint(int _x, int _y, std::shared_ptr<ExtensiveRelation> _relation, int _side=0): Constraint(_x, _y, true), relation{_relation}, side{_side} {};
+    ExtensiveConstraint(int _x, int _y, const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy): ExtensiveConstraint(_x, _y, std::make_shared<ExtensiveRelation>(Dx, Dy)) {};
 
-    std::unique_ptr<Constraint> clone() {return std::unique_ptr<ExtensiveConstraint>(new ExtensiveConstraint{*this});}
-    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>&, const std::unordered_set<int>&) {throw std::logic_error("Constraint is already extensive");};
+    std::unique_ptr<Constraint> clone() const{return std::make_unique<ExtensiveConstraint>(*this);}
+    std::unique_ptr<Constraint> transpose() const{return std::make_unique<ExtensiveConstraint>(y, x, relation, 1 - side);}
+    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>&, const std::unordered_set<int>&) const{throw std::logic_error("Constraint is already extensive");};
 
-    void addPair(int a, int b);
-    void removePair(int a, int b);
-    
-    bool feasible(int a, int b) const {return list.count(a)>0 && list.at(a).count(b);}
-    bool feasible(const std::unordered_map<int,int>& partSol) const{return feasible(partSol.at(x),partSol.at(y));}
+    void intern(RelationPool& pool);
+    // Referenced by this view and its transpose only
+    bool isShared() const{return relation.use_count() > 2;}
+    const std::shared_ptr<ExtensiveRelation>& getRelation() const{return relation;}
+    int getSide() const{return side;}
+    std::unique_ptr<Constraint> detach() const{return std::make_unique<ExtensiveConstraint>(x, y, std::make_shared<ExtensiveRelation>(*relation), side);}
+
+    void addPair(int a, int b) {relation->addPair(side, a, b);}
+    void removePair(int a, int b) {relation->removePair(side, a, b);}
 
-    std::vector<std::pair<int,int>> getUselessPairs(const std::unordered_set<int>& Dx) const;
+    bool feasible(int a, int b) const {return relation->feasible(side, a, b);}
+    bool feasible(const std::unordered_map<int,int>& partSol) const{return feasible(partSol.at(x),partSol.at(y));}
 
-    std::vector<int> getForbiddenValues(int a, const std::unordered_set<int>& Dy) const;
+    void getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
 
-    const std::unordered_set<int>& getSupport(int a) const {return list.at(a);}
-    size_t getSupportSize(int value) const {return list.count(value) ? list.at(value).size():0;}
+    void getSupport(int a, std::vector<int>& support) const {relation->getSupport(side, a, support);}
+    size_t getSupportSize(int value) const {return relation->getSupportSize(side, value);}
+    int getValueIndex(int a) const {return relation->getIndex(side, a);}
+    std::size_t nbValues() const {return relation->getValues(side).size();}
 
     void display() const;
 };
 
 
+// Feasibility function of an intensive constraint, shared by both directions
+struct IntensiveRelation {
+    std::function<bool(int,int)> feasibleFunction;
+    // Appends the values forbidden by a, whether in the domain or not
+    std::optional<std::function<void(int,std::vector<int>&)>> forbiddenValuesFunction;
+    // f(a,b) == f(b,a): both directions call the functions with their own (a,b)
+    bool symmetric;
+};
+
 class IntensiveConstraint: public Constraint {
 
 protected:
-    std::function<bool(int,int)> feasibleFunction;
-    std::optional<std::function<std::vector<int>(int)>> forbiddenValuesFunction;
+    std::shared_ptr<const IntensiveRelation> relation;
+    bool transposed;
 
 public:
-    IntensiveConstraint(int _x, int _y, std::function<bool(int,int)> _feasibleFunction, std::optional<std::function<std::vector<int>(int)>> _forbiddenValuesFunction) : Constraint(_x, _y), feasibleFunction{_feasibleFunction}, forbiddenValuesFunction(_forbiddenValuesFunction) {}
+    IntensiveConstraint(int _x, int _y, std::shared_ptr<const IntensiveRelation> _relation, bool _transposed=false) : Constraint(_x, _y), relation{_relation}, transposed{_transposed} {}
 
-    std::unique_ptr<Constraint> clone() {return std::unique_ptr<IntensiveConstraint>(new IntensiveConstraint{*this});}
-    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy);
+    std::unique_ptr<Constraint> clone() const{return std::make_unique<IntensiveConstraint>(*this);}
+    std::unique_ptr<Constraint> transpose() const{return std::make_unique<IntensiveConstraint>(y, x, relation, !transposed);}
+    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const;
 
     void addPair(int, int) {throw std::logic_error("Cannot add pair to intensive constraint");};
     void removePair(int, int){throw std::logic_error("Cannot remove pair from intensive constraint");};
 
-    bool feasible(int a, int b) const{return feasibleFunction(a,b);}
+    bool feasible(int a, int b) const{return (transposed && !relation->symmetric) ? relation->feasibleFunction(b,a) : relation->feasibleFunction(a,b);}
     bool feasible(const std::unordered_map<int,int>& partSol) const{return feasible(partSol.at(x),partSol.at(y));}
 
-    std::vector<std::pair<int,int>> getUselessPairs(const std::unordered_set<int>&) const{return std::vector<std::pair<int,int>>();};
-
-    std::vector<int> getForbiddenValues(int a, const std::unordered_set<int>& Dy) const;
-    std::vector<int> getForbiddenValuesDefault(int a, const std::unordered_set<int>& Dy) const;
-    std::vector<int> getForbiddenValuesSmart(int a, const std::unordered_set<int>& Dy) const;
+    void getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
+    void getForbiddenValuesDefault(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
+    void getForbiddenValuesSmart(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
 
-    const std::unordered_set<int>& getSupport(int) const{throw std::logic_error("Not implemented lol");};
+    void getSupport(int, std::vector<int>&) const{throw std::logic_error("Not implemented lol");};
     size_t getSupportSize(int) const{throw std::logic_error("Not implemented lol");};
 
     void display() const {std::cout << x << "," << y << ": Intensive constraint"<<std::endl;}
@@ -108,8 +196,9 @@ class DifferenceConstraint: public Constraint {
 public:
     DifferenceConstraint(int _x, int _y) : Constraint(_x, _y) {}
 
-    std::unique_ptr<Constraint> clone() {return std::unique_ptr<DifferenceConstraint>(new DifferenceConstraint{*this});}
-    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy);
+    std::unique_ptr<Constraint> clone() const{return std::make_unique<DifferenceConstraint>(*this);}
+    std::unique_ptr<Constraint> transpose() const{return std::make_unique<DifferenceConstraint>(y, x);}
+    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const;
 
     void addPair(int, int) {throw std::logic_error("Cannot add pair to intensive constraint");};
     void removePair(int, int){throw std::logic_error("Cannot remove pair from intensive constraint");};
@@ -117,14 +206,74 @@ public:
     bool feasible(int a, int b) const{return a!=b;}
     bool feasible(const std::unordered_map<int,int>& partSol) const{return feasible(partSol.at(x),partSol.at(y));}
 
-    std::vector<std::pair<int,int>> getUselessPairs(const std::unordered_set<int>&) const{return std::vector<std::pair<int,int>>();};
-
-    std::vector<int> getForbiddenValues(int a, const std::unordered_set<int>& Dy) const;
+    void getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
 
-    const std::unordered_set<int>& getSupport(int) const{throw std::logic_error("Not implemented lol");};
+    void getSupport(int, std::vector<int>&) const{throw std::logic_error("Not implemented lol");};
     size_t getSupportSize(int) const{throw std::logic_error("Not implemented lol");};
 
     void display() const {std::cout << x << "," << y << ": Difference constraint"<<std::endl;}
 };
 
-#endif
\ No newline at end of file
+// Placements of a nonogram line, with one bitset over the placements per cell
+// telling which of them fill the cell
+class LinePatterns {
+
+private:
+    std::size_t nbPatterns;
+    std::size_t words;
+    std::vector<uint64_t> filled;
+
+public:
+    LinePatterns(const std::vector<std::vector<bool>>& patterns, std::size_t length);
+
+    std::size_t size() const{return nbPatterns;}
+    bool isFilled(int pattern, std::size_t cell) const{return (filled[cell * words + (std::size_t)(pattern) / 64] >> ((std::size_t)(pattern) % 64)) & 1;}
+};
+
+// Placements of a column x and of a row y agree on their common cell
+class PatternConstraint: public Constraint {
+
+protected:
+    std::shared_ptr<const LinePatterns> xPatterns;
+    std::size_t xCell;
+    std::shared_ptr<const LinePatterns> yPatterns;
+    std::size_t yCell;
+
+public:
+    PatternConstraint(int _x, int _y, std::shared_ptr<const LinePatterns> _xPatterns, std::size_t _xCell, std::shared_ptr<const LinePatterns> _yPatterns, std::size_t _yCell) :
+        Constraint(_x, _y), xPatterns{_xPatterns}, xCell{_xCell}, yPatterns{_yPatterns}, yCell{_yCell} {}
+
+    std::unique_ptr<Constraint> clone() const{return std::make_unique<PatternConstraint>(*this);}
+    std::unique_ptr<Constraint> transpose() const{return std::make_unique<PatternConstraint>(y, x, yPatterns, yCell, xPatterns, xCell);}
+    std::unique_ptr<Constraint> extensify(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy) const;
+
+    void addPair(int, int) {throw std::logic_error("Cannot add pair to pattern constraint");};
+    void removePair(int, int){throw std::logic_error("Cannot remove pair from pattern constraint");};
+
+    bool feasible(int a, int b) const{return xPatterns->isFilled(a, xCell) == yPatterns->isFilled(b, yCell);}
+    bool feasible(const std::unordered_map<int,int>& partSol) const{return feasible(partSol.at(x),partSol.at(y));}
+
+    void getForbiddenValues(int a, const std::unordered_set<int>& Dy, std::vector<int>& forbidden) const;
+    void getUnsupported(const std::unordered_set<int>& Dx, const std::unordered_set<int>& Dy, std::vector<int>& unsupported) const;
+
+    void getSupport(int, std::vector<int>&) const{throw std::logic_error("Not implemented lol");};
+    size_t getSupportSize(int) const{throw std::logic_error("Not implemented lol");};
+
+    void display() const {std::cout << x << "," << y << ": Pattern constraint"<<std::endl;}
+};
+
+// Extensive relations deduplicated by content, in either orientation
+class RelationPool {
+
+private:
+    // hash of a view -> (relation, side of the view)
+    std::unordered_multimap<std::size_t, std::pair<std::shared_ptr<ExtensiveRelation>,int>> relations;
+    std::size_t nbRelations=0;
+
+public:
+    // Return a pooled relation and side whose view equals the view (relation, side)
+    std::pair<std::shared_ptr<ExtensiveRelation>,int> intern(const std::shared_ptr<ExtensiveRelation>& relation, int side);
+    std::size_t size() const{return nbRelations;}
+};
+
+#endif
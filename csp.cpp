@@ -3,21 +3,38 @@
 #include <cassert>
 #include <typeinfo>
 #include <fstream>
+#include <algorithm>
 
 #include "csp.h"
+#include "modelfile.h"
+#include "nonogramline.h"
+#include "sudokuunit.h"
+#include "queensdiagonals.h"
 
 CSP::CSP(const CSP& csp) {
     variables = csp.getVariables();
     domains = csp.getDomains();
     for (const auto& [x,Cx]: csp.getConstraints()) {
         constraints.emplace(x,std::unordered_map<int,std::unique_ptr<Constraint>>());
+    }
+    for (const auto& [x,Cx]: csp.getConstraints()) {
         for (const auto& [y,Cxy]: Cx) {
-            constraints.at(x).emplace(y,Cxy->clone()); // Copy unique ptrs
+            if (x>y) continue; // the symmetric constraint is a view of the same relation
+            std::unique_ptr<Constraint> copy = Cxy->clone(); // relations are shared until modified
+            constraints.at(y).emplace(x,copy->transpose());
+            constraints.at(x).emplace(y,std::move(copy));
         }
     }
     nConstraints = csp.nbConstraints();
     allDifferentFamilies = csp.allDifferentFamilies;
     problemType = csp.problemType;
+    colorLowerBound = csp.colorLowerBound;
+    extensionBudget = csp.extensionBudget;
+    extensionSize = csp.extensionSize;
+    relations = csp.relations;
+    propagators = csp.propagators;
+    model = csp.model;
+    boundColors = csp.boundColors;
 }
 
 void CSP::addVariable(int var) {
@@ -31,7 +48,7 @@ void CSP::addVariable(int var) {
 
 void CSP::addVariableValue(int var, int value) {
     assert(domains.count(var));
-    domains.at(var).emplace(value);
+    domainNodes.insert(domains.at(var), value);
 }
 
 void CSP::addVariableRange(int var, int start, int end) {
@@ -41,7 +58,7 @@ void CSP::addVariableRange(int var, int start, int end) {
 }
 
 bool CSP::removeVariableValue(int var, int value) {
-    return domains.at(var).erase(value);
+    return domainNodes.erase(domains.at(var), value);
 }
 
 bool CSP::isInDomain(int var, int value) {
@@ -49,23 +66,42 @@ bool CSP::isInDomain(int var, int value) {
 }
 
 void CSP::fixValue(int var, int value) {
-    domains.at(var) = std::unordered_set<int> {value};
+    std::unordered_set<int>& domain = domains.at(var);
+    if (domain.size() == 1 && *domain.begin() == value) return;
+    domainNodes.clear(domain);
+    domainNodes.insert(domain, value);
 }
 
 void CSP::addConstraint(int x, int y) {
     assert(x!=y);
     assert(constraints.count(x));
     if (constraints.at(x).count(y)) return;
-    constraints.at(x).emplace(y,std::make_unique<ExtensiveConstraint>(x,y));
-    
+    std::unique_ptr<Constraint> Cxy = std::make_unique<ExtensiveConstraint>(x,y,domains.at(x),domains.at(y));
+
     // add the symmetric constraint
     assert(constraints.count(y));
     assert(constraints.at(y).count(x) == 0);
-    constraints.at(y).emplace(x,std::make_unique<ExtensiveConstraint>(y,x));
+    constraints.at(y).emplace(x,Cxy->transpose());
+    constraints.at(x).emplace(y,std::move(Cxy));
     
     nConstraints++;
 }
 
+void CSP::addConstraint(int x, int y, std::shared_ptr<ExtensiveRelation> relation, int side) {
+    assert(x!=y);
+    assert(constraints.count(x));
+    if (constraints.at(x).count(y)) return;
+    std::unique_ptr<Constraint> Cxy = std::make_unique<ExtensiveConstraint>(x,y,relation,side);
+
+    // add the symmetric constraint
+    assert(constraints.count(y));
+    assert(constraints.at(y).count(x) == 0);
+    constraints.at(y).emplace(x,Cxy->transpose());
+    constraints.at(x).emplace(y,std::move(Cxy));
+
+    nConstraints++;
+}
+
 void CSP::addConstraint(int x, int y, const std::function<bool(int,int)>& validPair) {
     addConstraint(x,y);
     for (int a : domains.at(x)) {
@@ -77,20 +113,19 @@ void CSP::addConstraint(int x, int y, const std::function<bool(int,int)>& validP
     }
 }
 
-void CSP::addIntensiveConstraint(int x, int y, const std::function<bool(int,int)>& validPair, bool symetricFunction, const std::optional<std::function<std::vector<int>(int)>>& forbiddenValuesFunction) {
+void CSP::addIntensiveConstraint(int x, int y, const std::function<bool(int,int)>& validPair, bool symetricFunction, const std::optional<std::function<void(int,std::vector<int>&)>>& forbiddenValuesFunction) {
     assert(x!=y);
     assert(constraints.count(x));
     assert(symetricFunction || !forbiddenValuesFunction.has_value());
     if (constraints.at(x).count(y)) return;
-    constraints.at(x).emplace(y,std::make_unique<IntensiveConstraint>(x,y,validPair,forbiddenValuesFunction));
+    auto relation = std::make_shared<const IntensiveRelation>(IntensiveRelation{validPair,forbiddenValuesFunction,symetricFunction});
+    std::unique_ptr<Constraint> Cxy = std::make_unique<IntensiveConstraint>(x,y,relation);
 
     // add the symmetric constraint
     assert(constraints.count(y));
     assert(constraints.at(y).count(x) == 0);
-    if (symetricFunction)
-        constraints.at(y).emplace(x,std::make_unique<IntensiveConstraint>(y,x,validPair,forbiddenValuesFunction));
-    else 
-        constraints.at(y).emplace(x,std::make_unique<IntensiveConstraint>(y,x,[validPair] (int b, int a){return validPair(a,b);},forbiddenValuesFunction));
+    constraints.at(y).emplace(x,Cxy->transpose());
+    constraints.at(x).emplace(y,std::move(Cxy));
     
     nConstraints++;
 }
@@ -99,23 +134,45 @@ void CSP::addDifferenceConstraint(int x, int y) {
     assert(x!=y);
     assert(constraints.count(x));
     if (constraints.at(x).count(y)) return;
-    constraints.at(x).emplace(y, std::make_unique<DifferenceConstraint>(x,y));
+    std::unique_ptr<Constraint> Cxy = std::make_unique<DifferenceConstraint>(x,y);
 
     assert(constraints.count(y));
     assert(constraints.at(y).count(x) == 0);
-    constraints.at(y).emplace(x, std::make_unique<DifferenceConstraint>(y,x));
+    constraints.at(y).emplace(x, Cxy->transpose());
+    constraints.at(x).emplace(y, std::move(Cxy));
+
+    nConstraints++;
+}
+
+void CSP::detachPair(int x, int y) {
+    std::unique_ptr<Constraint>& Cxy = constraints.at(x).at(y);
+    if (!Cxy->isShared()) return;
+    Cxy = Cxy->detach();
+    constraints.at(y).at(x) = Cxy->transpose();
+}
+
+void CSP::addPatternConstraint(int x, int y, std::shared_ptr<const LinePatterns> xPatterns, std::size_t xCell, std::shared_ptr<const LinePatterns> yPatterns, std::size_t yCell) {
+    assert(x!=y);
+    assert(constraints.count(x));
+    if (constraints.at(x).count(y)) return;
+    std::unique_ptr<Constraint> Cxy = std::make_unique<PatternConstraint>(x,y,xPatterns,xCell,yPatterns,yCell);
+
+    assert(constraints.count(y));
+    assert(constraints.at(y).count(x) == 0);
+    constraints.at(y).emplace(x, Cxy->transpose());
+    constraints.at(x).emplace(y, std::move(Cxy));
 
     nConstraints++;
 }
 
 void CSP::addConstraintValuePair(int x, int y, int a, int b) {
-    constraints.at(x).at(y)->addPair(a,b);
-    constraints.at(y).at(x)->addPair(b,a);// add symmetric constraint values
+    detachPair(x,y);
+    constraints.at(x).at(y)->addPair(a,b); // the symmetric constraint shares the relation
 }
 
 void CSP::removeConstraintValuePair(int x, int y, int a, int b) {
-    constraints.at(x).at(y)->removePair(a,b);
-    constraints.at(y).at(x)->removePair(b,a);// remove symmetric constraint values
+    detachPair(x,y);
+    constraints.at(x).at(y)->removePair(a,b); // the symmetric constraint shares the relation
 }
 
 void CSP::addAllDifferentConstraint(const std::vector<int>& vars) {
@@ -145,6 +202,10 @@ bool CSP::feasible(const std::unordered_map<int,int>& partSol) const{
         }
     }
 
+    for (const auto& propagator : propagators) {
+        if (!propagator->feasible(partSol)) return false;
+    }
+
     return true;
 }
 
@@ -162,6 +223,8 @@ bool CSP::feasible(const std::unordered_map<int,int>& partSol, int var, int valu
 }
 
 void CSP::init(const QueenProblem& problem){
+    if (model == "diagonals") return initDiagonalsModel(problem.nb_queens);
+    if (!model.empty()) throw std::logic_error("Wrong queens model: " + model);
     int n = problem.nb_queens;
 
     // Domains
@@ -176,7 +239,11 @@ void CSP::init(const QueenProblem& problem){
             addIntensiveConstraint(x,y, 
                     [x, y](int a, int b) {return a!=b && std::abs(a-b)!=std::abs(x-y);},
                     true,
-                    [x, y](int a) {return std::vector<int>{a,a+x-y,a-x+y};}
+                    [x, y](int a, std::vector<int>& forbidden) {
+                        forbidden.push_back(a);
+                        forbidden.push_back(a+x-y);
+                        forbidden.push_back(a-x+y);
+                    }
             );
         }
     }
@@ -187,6 +254,14 @@ void CSP::init(const QueenProblem& problem){
 }
 
 void CSP::init(const BlockedQueenProblem& problem){
+    if (model == "diagonals") {
+        initDiagonalsModel(problem.nb_queens);
+        for (auto [var,value] : problem.blockedSquares) {
+            removeVariableValue(var,value);
+        }
+        return;
+    }
+    if (!model.empty()) throw std::logic_error("Wrong queens model: " + model);
     int n = problem.nb_queens;
 
     // Domains
@@ -205,7 +280,11 @@ void CSP::init(const BlockedQueenProblem& problem){
             addIntensiveConstraint(x,y, 
                     [x, y](int a, int b) {return a!=b && std::abs(a-b)!=std::abs(x-y);},
                     true,
-                    [x, y](int a) {return std::vector<int>{a,a+x-y,a-x+y};}
+                    [x, y](int a, std::vector<int>& forbidden) {
+                        forbidden.push_back(a);
+                        forbidden.push_back(a+x-y);
+                        forbidden.push_back(a-x+y);
+                    }
             );        
         }
     }
@@ -215,6 +294,21 @@ void CSP::init(const BlockedQueenProblem& problem){
     addAllDifferentFamily(vars);
 }
 
+// Same variables as the pairwise model, with a single propagator for the columns and diagonals
+void CSP::initDiagonalsModel(int n) {
+    // Domains
+    for (int var=0; var<n; var++) {
+        addVariable(var);
+        addVariableRange(var, 0, n);
+    }
+
+    addPropagator(std::make_shared<QueensDiagonalsPropagator>(n));
+
+    std::vector<int> vars((unsigned int)(n),0);
+    std::iota(vars.begin(), vars.end(), 0);
+    addAllDifferentFamily(vars);
+}
+
 void CSP::readProblemType(std::string path) {
     std::ifstream inputFile(path);
     if (!inputFile.is_open()) {
@@ -231,6 +325,11 @@ void CSP::readProblemType(std::string path) {
 }
 
 void CSP::init(std::string path) {
+    if (ModelFile::isModelFile(path)) {
+        std::cout << "Loading compiled csp..." << std::endl;
+        ModelFile::read(path, *this);
+        return internRelations();
+    }
     readProblemType(path);
     std::cout << "Generating csp..." << std::endl;
     switch (problemType) 
@@ -240,7 +339,9 @@ void CSP::init(std::string path) {
     case Problem::Color: return init(ProblemReader::readColorProblem(path));
     case Problem::Sudoku: return init(ProblemReader::readSudokuProblem(path));
     case Problem::Nonogram: return init(ProblemReader::readNonogramProblem(path));
-    case Problem::Generic: return init(ProblemReader::readGenericProblem(path));
+    case Problem::Generic:
+        ProblemReader::readGenericProblem(path, *this);
+        return internRelations();
     default: std::cerr << "Wrong model" << path << std::endl;
     }
 }
@@ -248,6 +349,12 @@ void CSP::init(std::string path) {
 void CSP::init(const ColorProblem& problem) {
 
     int nbColors = problem.nb_colors;
+    // The reader's number of colors is no upper bound of the chromatic number, the DSATUR
+    // coloring is one
+    if (boundColors) {
+        const std::vector<int> coloring = problem.dsaturColoring();
+        nbColors = *std::max_element(coloring.begin(), coloring.end()) + 1;
+    }
 
     // Domains
     // Conventions on files -> starting from 1
@@ -260,12 +367,19 @@ void CSP::init(const ColorProblem& problem) {
     for (std::pair<int,int> edge : problem.edges) {
         addDifferenceConstraint(edge);
     }
-    std::pair<int,int> firstEdge = problem.edges[0];
-    fixValue(firstEdge.first,0);
-    fixValue(firstEdge.second,1);
+
+    // The vertices of a clique take different colors, which are interchangeable
+    std::vector<int> clique = problem.greedyClique();
+    colorLowerBound = (unsigned int)(clique.size());
+    for (int i=0; i<int(clique.size()); i++) {
+        if (i < nbColors) fixValue(clique[(std::size_t)(i)], i);
+        else domains.at(clique[(std::size_t)(i)]).clear(); // more vertices than colors
+    }
 }
 
 void CSP::init(const SudokuProblem& problem) {
+    if (model == "units") return initUnitModel(problem);
+    if (!model.empty()) throw std::logic_error("Wrong sudoku model: " + model);
     assert(problem.grid.size() == problem.n);
     unsigned int n = problem.n;
     int nInt = int(n); // to calm down gcc warnings
@@ -319,39 +433,93 @@ void CSP::init(const SudokuProblem& problem) {
     }
 }
 
+// Same variables as the pairwise model, with a bitmask propagator per row, column and box
+void CSP::initUnitModel(const SudokuProblem& problem) {
+    assert(problem.grid.size() == problem.n);
+    int n = int(problem.n);
+    int sqrLen = int(std::lround(sqrt(n)));
+
+    // Domains
+    for (int i=0; i<n; i++) {
+        for (int j=0; j<n; j++) {
+            int varIdx = n*i+j;
+            addVariable(varIdx);
+            int given = problem.grid[(unsigned int)(i)][(unsigned int)(j)];
+            if (given > 0) addVariableValue(varIdx, given);
+            else addVariableRange(varIdx, 1, n + 1);
+        }
+    }
+
+    // Propagators
+    for (int k=0; k<n; k++) {
+        std::vector<int> line, column, square;
+        int iSqr = (k / sqrLen) * sqrLen;
+        int jSqr = (k % sqrLen) * sqrLen;
+        for (int l=0; l<n; l++) {
+            line.push_back(n*k+l);
+            column.push_back(n*l+k);
+            square.push_back(n*(iSqr + l / sqrLen) + jSqr + l % sqrLen);
+        }
+        addPropagator(std::make_shared<SudokuUnitPropagator>(line));
+        addPropagator(std::make_shared<SudokuUnitPropagator>(column));
+        addPropagator(std::make_shared<SudokuUnitPropagator>(square));
+    }
+}
+
 void CSP::init(const NonogramProblem& problem) {
-    std::vector<std::vector<std::vector<bool>>> allVerticalPossibilities;
-    std::vector<std::vector<std::vector<bool>>> allHorizontalPossibilities;
+    if (model == "line") return initLineModel(problem);
+    if (!model.empty()) throw std::logic_error("Wrong nonogram model: " + model);
+
+    std::vector<std::shared_ptr<const LinePatterns>> verticalPatterns;
+    std::vector<std::shared_ptr<const LinePatterns>> horizontalPatterns;
 
     int w = int(problem.w);
     int h = int(problem.h);
 
     // Domains
     for (int i=0; i<w; i++) {
-        allVerticalPossibilities.push_back(problem.getAllPossible(problem.verticalClues[(unsigned int)(i)], problem.h));
+        verticalPatterns.push_back(std::make_shared<const LinePatterns>(problem.getAllPossible(problem.verticalClues[(unsigned int)(i)], problem.h), problem.h));
         addVariable(i);
-        addVariableRange(i, 0, int(allVerticalPossibilities.back().size()));
+        addVariableRange(i, 0, int(verticalPatterns.back()->size()));
     }
     for (int j=0; j<h; j++) {
-        allHorizontalPossibilities.push_back(problem.getAllPossible(problem.horizontalClues[(unsigned int)(j)], problem.w));
+        horizontalPatterns.push_back(std::make_shared<const LinePatterns>(problem.getAllPossible(problem.horizontalClues[(unsigned int)(j)], problem.w), problem.w));
         addVariable(w + j);
-        addVariableRange(w + j, 0, int(allHorizontalPossibilities.back().size()));
+        addVariableRange(w + j, 0, int(horizontalPatterns.back()->size()));
     }
 
-    // Constraints
+    // Constraints: cell (i,j) is cell j of column i and cell i of row j
     for (int i=0; i<w; i++) {
         for (int j=0; j<h; j++) {
-            std::vector<bool> iValues(getDomainSize(i));
-            for (int a : getDomain(i)) {
-                iValues[(unsigned int)(a)] = allVerticalPossibilities[(unsigned int)(i)][(unsigned int)(a)][(unsigned int)(j)];
-            }
-            std::vector<bool> jValues(getDomainSize(w+j));
-            for (int b : getDomain(w+j)) {
-                jValues[(unsigned int)(b)] = allHorizontalPossibilities[(unsigned int)(j)][(unsigned int)(b)][(unsigned int)(i)];
-            }
-            addIntensiveConstraint(i, w + j, [iValues,jValues](int a, int b) {return iValues[(unsigned int)(a)] == jValues[(unsigned int)(b)];});
+            addPatternConstraint(i, w + j, verticalPatterns[(unsigned int)(i)], (std::size_t)(j), horizontalPatterns[(unsigned int)(j)], (std::size_t)(i));
+        }
+    }
+}
+
+// Boolean variable per cell, 1 if it is black, and a line propagator per row and column
+void CSP::initLineModel(const NonogramProblem& problem) {
+    int w = int(problem.w);
+    int h = int(problem.h);
+
+    // Cell (i,j) of column i and row j
+    for (int j=0; j<h; j++) {
+        for (int i=0; i<w; i++) {
+            addVariable(j*w + i);
+            addVariableRange(j*w + i, 0, 2);
         }
     }
+
+    // Propagators
+    for (int i=0; i<w; i++) {
+        std::vector<int> column;
+        for (int j=0; j<h; j++) column.push_back(j*w + i);
+        addPropagator(std::make_shared<NonogramLinePropagator>(column, problem.verticalClues[(unsigned int)(i)]));
+    }
+    for (int j=0; j<h; j++) {
+        std::vector<int> row;
+        for (int i=0; i<w; i++) row.push_back(j*w + i);
+        addPropagator(std::make_shared<NonogramLinePropagator>(row, problem.horizontalClues[(unsigned int)(j)]));
+    }
 }
 
 void CSP::init(const GenericProblem& problem) {
@@ -373,18 +541,47 @@ void CSP::init(const GenericProblem& problem) {
             addConstraintValuePair(vars,values);
         }
     }
+    internRelations();
+}
+
+void CSP::extensifyPair(int x, int y) {
+    std::unique_ptr<Constraint>& Cxy = constraints.at(x).at(y);
+    Cxy = Cxy->extensify(domains.at(x), domains.at(y));
+    Cxy->intern(relations);
+    constraints.at(y).at(x) = Cxy->transpose();
+}
+
+void CSP::internRelations() {
+    for (auto& [x,Cx] : constraints) {
+        for (auto& [y,Cxy] : Cx) {
+            if (x>y || !Cxy->isExtensive) continue;
+            Cxy->intern(relations);
+            constraints.at(y).at(x) = Cxy->transpose();
+        }
+    }
 }
 
 void CSP::extensify() {
     for (auto& [x,Cx] : constraints) {
         for (auto& [y,Cxy] : Cx) {
-            if (!Cxy->isExtensive) {
-                Cxy = Cxy->extensify(domains.at(x), domains.at(y));
-            }
+            if (x<y && !Cxy->isExtensive) extensifyPair(x,y);
         }
     }
 }
 
+bool CSP::extensify(int x, int y) {
+    if (constraints.at(x).at(y)->isExtensive) return true;
+
+    std::size_t sizeX = domains.at(x).size();
+    std::size_t sizeY = domains.at(y).size();
+    // Even when an identical relation is already in the pool, the pair builds its own before
+    // interning it, and AC4 keeps a support count per value on both of its arcs
+    std::size_t size = ExtensiveRelation::estimateSize(sizeX, sizeY) + (sizeX + sizeY) * sizeof(unsigned int);
+    if (extensionSize + size > extensionBudget) return false;
+    extensifyPair(x,y);
+    extensionSize += size;
+    return true;
+}
 
 void CSP::display(bool removeSymmetry) const {
     std::cout << "VARIABLES" << std::endl;
@@ -409,6 +606,9 @@ void CSP::display(bool removeSymmetry) const {
             Cxy->display();
         }
     }
+    for (const auto& propagator : propagators) {
+        propagator->display();
+    }
     std::cout << std::endl;
 }
 
@@ -416,4 +616,8 @@ std::vector<int> CSP::getDomainCopy(int var) const {
     std::vector<int> copy(domains.at(var).size());
     std::copy(domains.at(var).begin(), domains.at(var).end(), copy.begin());
     return copy;
+}
+
+void CSP::getDomainCopy(int var, std::vector<int>& copy) const {
+    copy.assign(domains.at(var).begin(), domains.at(var).end());
 }
\ No newline at end of file
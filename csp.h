@@ -9,7 +9,9 @@
 #include <thread>
 #include <optional>
 #include "constraint.h"
+#include "propagator.h"
 #include "problemreader.h"
+#include "nodepool.h"
 #include <random>
 
 enum class Problem {Queens, BlockedQueens, Color, Sudoku, Nonogram, Generic};
@@ -18,12 +20,33 @@ class CSP {
 private:
     std::unordered_set<int> variables;
     std::unordered_map<int,std::unordered_set<int>> domains;
+    // Nodes of the removed values, reused when values come back on backtrack
+    NodePool<std::unordered_set<int>> domainNodes;
     std::unordered_map<int,std::unordered_map<int,std::unique_ptr<Constraint>>> constraints;
-    Problem problemType;
+    Problem problemType=Problem::Generic;
 
     std::vector<std::vector<int>> allDifferentFamilies;
+    // Global constraints, cloned by each solver
+    std::vector<std::shared_ptr<const Propagator>> propagators;
+    // Alternative model of the problem type, empty for the default one
+    std::string model;
+    // Graph coloring: size of the clique fixed by init, a lower bound on the number of colors
+    unsigned int colorLowerBound=0;
+    // Graph coloring: keep only the colors of a DSATUR coloring, for the chromatic number search
+    bool boundColors=false;
 
     unsigned int nConstraints=0;
+
+    // Memory allowed for constraints turned extensive by extensify(x,y), with their support counts
+    std::size_t extensionBudget=std::size_t(1) << 30;
+    std::size_t extensionSize=0;
+
+    RelationPool relations;
+
+    // Replace the constraint x->y by its extension, interned in the pool, and y->x by its transpose
+    void extensifyPair(int x, int y);
+    // Give the pair x,y its own copy of its relation before it is modified
+    void detachPair(int x, int y);
 public:
 
     CSP(){};
@@ -34,6 +57,10 @@ public:
     std::size_t sizeDomain(int var) const{return domains.at(var).size();}
     unsigned int nbConstraints() const {return nConstraints;}
     Problem getProblemType() const {return problemType;}
+    void setProblemType(Problem _problemType) {problemType = _problemType;}
+    unsigned int getColorLowerBound() const {return colorLowerBound;}
+    void setColorLowerBound(unsigned int _colorLowerBound) {colorLowerBound = _colorLowerBound;}
+    const std::string& getModel() const {return model;}
 
     void addVariable(int var);
     void addVariableValue(int var, int value);
@@ -43,14 +70,18 @@ public:
     bool isInDomain(int var, int value);
     void addConstraint(int x, int y);
     void addConstraint(int x, int y, const std::function<bool(int,int)>& validPair);
+    // Constraint x->y reading relation from side, which other pairs may share
+    void addConstraint(int x, int y, std::shared_ptr<ExtensiveRelation> relation, int side);
     void addConstraint(std::pair<int,int> pair) {return addConstraint(pair.first, pair.second);}
     void addConstraint(std::pair<int,int> pair, const std::function<bool(int,int)>& validPair) {return addConstraint(pair.first, pair.second, validPair);}
-    void addIntensiveConstraint(int x, int y, const std::function<bool(int,int)>& validPair, bool symetricFunction=false, const std::optional<std::function<std::vector<int>(int)>>& forbiddenValuesFunction={});
-    void addIntensiveConstraint(std::pair<int,int> pair, const std::function<bool(int,int)>& validPair, bool symetricFunction=false, const std::optional<std::function<std::vector<int>(int)>>& forbiddenValuesFunction={}) {return addIntensiveConstraint(pair.first, pair.second, validPair, symetricFunction, forbiddenValuesFunction);};
+    void addIntensiveConstraint(int x, int y, const std::function<bool(int,int)>& validPair, bool symetricFunction=false, const std::optional<std::function<void(int,std::vector<int>&)>>& forbiddenValuesFunction={});
+    void addIntensiveConstraint(std::pair<int,int> pair, const std::function<bool(int,int)>& validPair, bool symetricFunction=false, const std::optional<std::function<void(int,std::vector<int>&)>>& forbiddenValuesFunction={}) {return addIntensiveConstraint(pair.first, pair.second, validPair, symetricFunction, forbiddenValuesFunction);};
     void addDifferenceConstraint(int x, int y);
     void addDifferenceConstraint(std::pair<int,int> pair) {return addDifferenceConstraint(pair.first, pair.second);};
+    void addPatternConstraint(int x, int y, std::shared_ptr<const LinePatterns> xPatterns, std::size_t xCell, std::shared_ptr<const LinePatterns> yPatterns, std::size_t yCell);
     void addAllDifferentConstraint(const std::vector<int>& vars);
     void addAllDifferentFamily(const std::vector<int>& vars) {allDifferentFamilies.push_back(vars);}
+    void addPropagator(std::shared_ptr<const Propagator> propagator) {propagators.push_back(propagator);}
 
     void addConstraintValuePair(int x, int y, int a, int b);
     void addConstraintValuePair(std::pair<int,int> vars, std::pair<int,int> values) {return addConstraintValuePair(vars.first, vars.second, values.first, values.second);}
@@ -62,25 +93,48 @@ public:
    
     const std::unordered_set<int>& getDomain(int var) const{return domains.at(var);}
     std::vector<int> getDomainCopy(int var) const;
+    // Same, reusing the memory of copy
+    void getDomainCopy(int var, std::vector<int>& copy) const;
+    // Exchange the domain of var with domain, in constant time
+    void swapDomain(int var, std::unordered_set<int>& domain) {domains.at(var).swap(domain);}
     size_t getDomainSize(int var) const{return domains.at(var).size();}
 
-    const std::vector<std::vector<int>>& getAllDifferentFamilies() {return allDifferentFamilies;}
+    const std::vector<std::vector<int>>& getAllDifferentFamilies() const{return allDifferentFamilies;}
+    const std::vector<std::shared_ptr<const Propagator>>& getPropagators() const{return propagators;}
 
     bool feasible(const std::unordered_map<int,int>& partSol) const;
     // Check if the added variable do not produce infeasibility with the given value
     // assuming the partial solution without this variable is feasible
     bool feasible(const std::unordered_map<int,int>& partSol, int var, int value) const;
 
+    // Choose the model built by init: "line" for nonograms, "units" for sudokus,
+    // "diagonals" for queens and blocked queens
+    void setModel(const std::string& _model) {model = _model;}
+    // Bound the colors of a graph coloring by a DSATUR coloring. Colorings with more colors
+    // are lost, only the chromatic number search asks for it.
+    void setBoundColors(const bool _boundColors) {boundColors = _boundColors;}
+
     void readProblemType(std::string path);
     void init(std::string path);
     void init(const ColorProblem& problem);
     void init(const QueenProblem& problem);
     void init(const BlockedQueenProblem& problem);
+    void initDiagonalsModel(int n);
     void init(const SudokuProblem& problem);
+    void initUnitModel(const SudokuProblem& problem);
     void init(const NonogramProblem& problem);
+    void initLineModel(const NonogramProblem& problem);
     void init(const GenericProblem& problem);
 
     void extensify();
+    // Turn the constraints between x and y extensive over the current domains,
+    // unless it would exceed the extension budget. Return true if they are extensive.
+    bool extensify(int x, int y);
+    void setExtensionBudget(std::size_t bytes) {extensionBudget = bytes;}
+    std::size_t getExtensionSize() const{return extensionSize;}
+    // Share identical extensive relations between pairs of variables
+    void internRelations();
+    std::size_t nbRelations() const{return relations.size();}
     
     void display(bool removeSymmetry = true) const;
 };
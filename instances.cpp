@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <numeric>
+#include <algorithm>
 
 std::vector<std::vector<bool>> NonogramProblem::getAllPossible(const std::vector<unsigned int>& clues, unsigned int n) const{
     assert(!clues.empty());
@@ -44,3 +45,65 @@ void NonogramProblem::recursiveComplete(const std::vector<unsigned int>& clues,
         curSol[i] = 0;
     }
 }
+
+std::vector<std::vector<int>> ColorProblem::getNeighbors() const{
+    std::vector<std::vector<int>> neighbors((std::size_t)(nb_nodes) + 1);
+    for (auto [x,y] : edges) {
+        if (x == y) continue;
+        neighbors[(std::size_t)(x)].push_back(y);
+        neighbors[(std::size_t)(y)].push_back(x);
+    }
+    for (std::vector<int>& vertexNeighbors : neighbors) {
+        std::sort(vertexNeighbors.begin(), vertexNeighbors.end());
+        vertexNeighbors.erase(std::unique(vertexNeighbors.begin(), vertexNeighbors.end()), vertexNeighbors.end());
+    }
+    return neighbors;
+}
+
+std::vector<int> ColorProblem::greedyClique() const{
+    const std::vector<std::vector<int>> neighbors = getNeighbors();
+    auto degree = [&neighbors](int vertex) {return neighbors[(std::size_t)(vertex)].size();};
+    std::vector<int> best;
+    std::vector<char> isNeighbor((std::size_t)(nb_nodes) + 1, false);
+    for (int seed=1; seed<=nb_nodes; seed++) {
+        if (degree(seed) + 1 <= best.size()) continue;
+        std::vector<int> clique = {seed};
+        std::vector<int> candidates = neighbors[(std::size_t)(seed)];
+        while (!candidates.empty()) {
+            int next = *std::max_element(candidates.begin(), candidates.end(), [&degree](int a, int b) {return degree(a) < degree(b);});
+            clique.push_back(next);
+            for (int vertex : neighbors[(std::size_t)(next)]) isNeighbor[(std::size_t)(vertex)] = true;
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&isNeighbor](int vertex) {return !isNeighbor[(std::size_t)(vertex)];}), candidates.end());
+            for (int vertex : neighbors[(std::size_t)(next)]) isNeighbor[(std::size_t)(vertex)] = false;
+        }
+        if (clique.size() > best.size()) best = clique;
+    }
+    return best;
+}
+
+std::vector<int> ColorProblem::dsaturColoring() const{
+    const std::vector<std::vector<int>> neighbors = getNeighbors();
+    const std::size_t n = (std::size_t)(nb_nodes);
+    std::vector<int> colors(n + 1, -1);
+    // Colors of the colored neighbors of each vertex
+    std::vector<std::vector<char>> neighborColors(n + 1);
+    std::vector<int> saturation(n + 1, 0);
+    for (std::size_t step=0; step<n; step++) {
+        std::size_t best = 0;
+        for (std::size_t vertex=1; vertex<=n; vertex++) {
+            if (colors[vertex] >= 0) continue;
+            if (best == 0 || saturation[vertex] > saturation[best] 
+                || (saturation[vertex] == saturation[best] && neighbors[vertex].size() > neighbors[best].size())) best = vertex;
+        }
+        std::vector<char>& used = neighborColors[best];
+        int color = int(std::find(used.begin(), used.end(), false) - used.begin());
+        colors[best] = color;
+        for (int neighbor : neighbors[best]) {
+            std::vector<char>& neighborUsed = neighborColors[(std::size_t)(neighbor)];
+            if (neighborUsed.size() <= (std::size_t)(color)) neighborUsed.resize((std::size_t)(color) + 1, false);
+            if (!neighborUsed[(std::size_t)(color)]) saturation[(std::size_t)(neighbor)]++;
+            neighborUsed[(std::size_t)(color)] = true;
+        }
+    }
+    return colors;
+}
@@ -18,6 +18,14 @@ struct ColorProblem {
     int nb_nodes;
     int nb_edges;
     std::vector<std::pair<int,int>> edges;
+
+    // Neighbors of each vertex, numbered from 1
+    std::vector<std::vector<int>> getNeighbors() const;
+    // Clique grown from each vertex by adding the candidate of highest degree,
+    // its size is a lower bound on the number of colors
+    std::vector<int> greedyClique() const;
+    // Color of each vertex given by DSATUR, colors and vertices numbered from 0 and 1
+    std::vector<int> dsaturColoring() const;
 };
 
 struct QueenProblem {
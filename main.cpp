@@ -1,7 +1,26 @@
 #include <iostream>
 #include <cassert>
+#include <fstream>
+#include <chrono>
 
 #include "solver.h"
+#include "modelfile.h"
+#include "batch.h"
+#ifndef NDEBUG
+#include "allocationcounter.h"
+#endif
+
+// Optional trailing arguments of the form key=value
+std::unordered_map<std::string,std::string> readOptions(int argc, char** argv, int first) {
+    std::unordered_map<std::string,std::string> options;
+    for (int i=first; i<argc; i++) {
+        const std::string option = argv[i];
+        std::size_t sep = option.find('=');
+        if (sep == std::string::npos) throw std::logic_error("Options must be given as key=value: " + option);
+        options[option.substr(0, sep)] = option.substr(sep + 1);
+    }
+    return options;
+}
 
 int main(int argc, char** argv) {
     bool isTest = (argc > 1);
@@ -23,14 +42,102 @@ int main(int argc, char** argv) {
         const bool _displaySolution = std::stoi(argv[11]);
         const bool _checkIfFoundSolution = std::stoi(argv[12]);
         const bool _checkSolveAtRoot = std::stoi(argv[13]);
+        const std::unordered_map<std::string,std::string> options = readOptions(argc, argv, 14);
 
         const std::vector<std::string> parameters = {_rootSolveMethod, _nodeSolveMethod, _variableChooser, 
                                                     _valueChooser, _timeLimit, _randomSeed, _nbSolutions, _allDifferent};
 
-        CSP csp(_modelPath);
+        // batch=sudoku|blocked_queens solves one instance per line of filePath, or of the
+        // standard input if it is "-", with threads=N solvers and writes one solution per line
+        if (options.count("batch")) {
+            const std::string model = options.count("model") ? options.at("model") : "";
+            const unsigned int nbThreads = options.count("threads") ? (unsigned int)(std::stoul(options.at("threads"))) : std::thread::hardware_concurrency();
+            BatchSolver batch(options.at("batch"), model, parameters, nbThreads);
+            const auto start = std::chrono::steady_clock::now();
+            if (_modelPath == "-") batch.run(std::cin, std::cout);
+            else {
+                std::ifstream input(_modelPath);
+                if (!input.is_open()) throw std::logic_error("Cannot open file - check the path you gave me");
+                batch.run(input, std::cout);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (_verbosity) {
+                std::cout << "Solved " << batch.getNbSolved() << "/" << batch.getNbInstances() << " instances in " << seconds << " s (";
+                std::cout << double(batch.getNbInstances()) / seconds << " instances/s) - " << batch.getNbNodesExplored() << " nodes explored" << std::endl;
+            }
+            if (_checkIfFoundSolution) assert(batch.getNbSolved() == batch.getNbInstances());
+            if (_checkSolveAtRoot) assert(batch.getNbNodesExplored() == 0);
+            return 0;
+        }
+
+        CSP csp;
+        // model=line|units|diagonals builds the alternative model of the problem type
+        if (options.count("model")) csp.setModel(options.at("model"));
+        // optimize=1 looks for the chromatic number of a graph coloring, from a DSATUR coloring
+        const bool minimizeColors = options.count("optimize") && std::stoi(options.at("optimize"));
+        csp.setBoundColors(minimizeColors);
+        csp.init(_modelPath);
+        // extensionBudget=MB bounds the memory of the tables built for AC4 and of their support counts
+        if (options.count("extensionBudget")) csp.setExtensionBudget(std::stoul(options.at("extensionBudget")) << 20);
         Solver solver(csp, parameters, _verbosity);
+        // count=1 counts the solutions without storing them, with bitboards for queens
+        if (options.count("count")) solver.setCountOnly(std::stoi(options.at("count")));
+        solver.setMinimizeColors(minimizeColors);
+        // symmetry=1 tries a single unused color at each branch of a graph coloring
+        if (options.count("symmetry")) solver.setBreakColorSymmetry(std::stoi(options.at("symmetry")));
+        // sac=1 adds singleton arc consistency to the presolve, probed by threads=N solvers
+        // for at most sacTime=seconds
+        if (options.count("sac")) solver.setSingletonConsistency(std::stoi(options.at("sac")));
+        if (options.count("sacTime")) solver.setSingletonTimeLimit(std::stod(options.at("sacTime")));
+        if (options.count("threads")) solver.setNbThreads((unsigned int)(std::stoul(options.at("threads"))));
+        else solver.setNbThreads(std::thread::hardware_concurrency());
+        // components=root|nodes solves the independent parts of the problem separately
+        if (options.count("components")) solver.setDecomposition(options.at("components"));
+        // peel=1 leaves the tree shaped parts out of the search and fills them in at the end
+        if (options.count("peel")) solver.setPeelTrees(std::stoi(options.at("peel")));
+        // btd=1 searches along a tree decomposition, recording goods and nogoods in btdMemory=MB
+        if (options.count("btd")) solver.setTreeDecompositionSearch(std::stoi(options.at("btd")));
+        if (options.count("btdMemory")) solver.setGoodsBudget(std::stoul(options.at("btdMemory")) << 20);
+        // output=path streams the solutions to a file instead of keeping them, outputFormat=text|binary
+        if (options.count("output")) {
+            const std::string format = options.count("outputFormat") ? options.at("outputFormat") : "text";
+            if (format != "text" && format != "binary") throw std::logic_error("Wrong output format");
+            solver.setSolutionSink(std::make_unique<SolutionWriter>(options.at("output"), format == "binary" ? SolutionWriter::Format::Binary : SolutionWriter::Format::Text));
+        }
 
-        solver.solve();
+        // dump=path writes the built model, dumpStage=init|extensify|presolve chooses when
+        if (options.count("dump")) {
+            const std::string dumpStage = options.count("dumpStage") ? options.at("dumpStage") : "init";
+            if (dumpStage == "presolve") solver.setDumpPath(options.at("dump"));
+            else {
+                CSP dumped(csp);
+                if (dumpStage == "extensify") dumped.extensify();
+                else if (dumpStage != "init") throw std::logic_error("Wrong dump stage");
+                ModelFile::write(dumped, options.at("dump"));
+                std::cout << "Model written to " << options.at("dump") << std::endl;
+            }
+        }
+
+#ifndef NDEBUG
+        const unsigned long nbAllocations = getNbAllocations();
+#endif
+        // stream=1 pulls the solutions one at a time, stopping the search after nbSolutions
+        if (options.count("stream") && std::stoi(options.at("stream"))) {
+            const unsigned long long nbWanted = (_nbSolutions == "all") ? ULLONG_MAX : std::stoull(_nbSolutions);
+            unsigned long long nbStreamed = 0;
+            for (const auto& solution : solver.streamSolutions()) {
+                assert(solution.size() == csp.nbVar());
+                assert(csp.feasible(solution));
+                if (++nbStreamed == nbWanted) break;
+            }
+            std::cout << "Streamed " << nbStreamed << " solution(s)" << std::endl;
+        } else solver.solve();
+#ifndef NDEBUG
+        if (_verbosity && solver.getNbNodesExplored()) {
+            const unsigned long nbSolveAllocations = getNbAllocations() - nbAllocations;
+            std::cout << nbSolveAllocations << " heap allocations during the solve (" << double(nbSolveAllocations) / double(solver.getNbNodesExplored()) << " per node)" << std::endl;
+        }
+#endif
 
         solver.checkFeasibility(csp);
         if (solver.hasFoundSolution()) solver.checkFeasibility(csp);
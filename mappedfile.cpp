@@ -0,0 +1,41 @@
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "mappedfile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::logic_error("Cannot open file - check the path you gave me");
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        void* data = mmap(nullptr, std::size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            mappedSize = std::size_t(fileStat.st_size);
+            madvise(data, mappedSize, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(data);
+        }
+    }
+    close(fd);
+    if (mappedSize == 0 && fileStat.st_size > 0) throw std::logic_error("Cannot map file " + path);
+#else
+    std::ifstream inputFile(path, std::ios::binary);
+    if (!inputFile.is_open()) throw std::logic_error("Cannot open file - check the path you gave me");
+    buffer.assign(std::istreambuf_iterator<char>(inputFile), std::istreambuf_iterator<char>());
+    begin = buffer.data();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mappedSize) munmap(const_cast<char*>(begin), mappedSize);
+#endif
+}
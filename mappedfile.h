@@ -0,0 +1,25 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <vector>
+
+// Read-only content of a whole file, memory mapped when the platform allows it
+class MappedFile {
+
+private:
+    const char* begin=nullptr;
+    std::size_t mappedSize=0;
+    std::vector<char> buffer; // used when the file cannot be memory mapped
+
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&)=delete;
+    MappedFile& operator=(const MappedFile&)=delete;
+    ~MappedFile();
+
+    const char* data() const{return begin;}
+    std::size_t size() const{return mappedSize ? mappedSize : buffer.size();}
+};
+
+#endif
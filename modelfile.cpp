@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "modelfile.h"
+#include "mappedfile.h"
+
+namespace {
+
+const char MAGIC[8] = {'B','C','S','P','M','D','L','\0'};
+const uint32_t VERSION = 2;
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+enum class RelationKind : uint32_t {Table=0, Difference=1};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t problemType;
+    uint64_t payloadSize;
+    uint64_t checksum;
+};
+
+uint64_t fnv1a(uint64_t hash, const char* data, std::size_t size) {
+    for (std::size_t i=0; i<size; i++) {
+        hash ^= (unsigned char)(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Buffered payload output, checksummed on the fly
+class PayloadWriter {
+private:
+    std::ofstream& out;
+    std::vector<char> buffer;
+
+    void flush() {
+        out.write(buffer.data(), std::streamsize(buffer.size()));
+        buffer.clear();
+    }
+
+public:
+    uint64_t size=0;
+    uint64_t checksum=FNV_OFFSET;
+
+    PayloadWriter(std::ofstream& _out) : out{_out} {buffer.reserve(1 << 20);}
+    ~PayloadWriter() {flush();}
+
+    void put(const void* data, std::size_t n) {
+        const char* bytes = static_cast<const char*>(data);
+        checksum = fnv1a(checksum, bytes, n);
+        size += n;
+        buffer.insert(buffer.end(), bytes, bytes + n);
+        if (buffer.size() >= (1 << 20)) flush();
+    }
+    void putUnsigned(uint32_t value) {put(&value, sizeof(value));}
+    void putInt(int32_t value) {put(&value, sizeof(value));}
+    void putWord(uint64_t value) {put(&value, sizeof(value));}
+};
+
+class PayloadReader {
+private:
+    const char* cur;
+    const char* end;
+
+public:
+    PayloadReader(const char* begin, std::size_t size) : cur{begin}, end{begin + size} {}
+
+    template<typename T>
+    T get() {
+        if (std::size_t(end - cur) < sizeof(T)) throw std::logic_error("Truncated model file");
+        T value;
+        std::memcpy(&value, cur, sizeof(T));
+        cur += sizeof(T);
+        return value;
+    }
+    // n values copied at once
+    template<typename T>
+    std::vector<T> getArray(std::size_t n) {
+        if (std::size_t(end - cur) / sizeof(T) < n) throw std::logic_error("Truncated model file");
+        std::vector<T> values(n);
+        if (n) std::memcpy(values.data(), cur, n * sizeof(T));
+        cur += n * sizeof(T);
+        return values;
+    }
+    bool done() const{return cur == end;}
+};
+
+std::vector<int> sortedDomain(const CSP& csp, int var) {
+    std::vector<int> domain = csp.getDomainCopy(var);
+    std::sort(domain.begin(), domain.end());
+    return domain;
+}
+
+}
+
+bool ModelFile::isModelFile(const std::string& path) {
+    std::ifstream inputFile(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!inputFile.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void ModelFile::write(const CSP& csp, const std::string& path) {
+    if (!csp.getPropagators().empty()) throw std::logic_error("Models with propagators cannot be compiled");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::logic_error("Cannot write model file " + path);
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.problemType = uint32_t(csp.getProblemType());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<int> variables(csp.getVariables().begin(), csp.getVariables().end());
+    std::sort(variables.begin(), variables.end());
+    std::unordered_map<int,std::vector<int>> domains;
+    {
+        PayloadWriter payload(out);
+
+        // Problem
+        payload.putUnsigned(csp.getColorLowerBound());
+        const std::string& model = csp.getModel();
+        payload.putUnsigned(uint32_t(model.size()));
+        payload.put(model.data(), model.size());
+
+        // Domains
+        payload.putUnsigned(uint32_t(variables.size()));
+        for (int var : variables) {
+            domains.emplace(var, sortedDomain(csp, var));
+            payload.putInt(var);
+            payload.putUnsigned(uint32_t(domains.at(var).size()));
+            for (int value : domains.at(var)) payload.putInt(value);
+        }
+
+        // Constraints, each pair once from its smallest variable
+        std::vector<std::pair<int,int>> pairs;
+        for (int x : variables) {
+            for (const auto& [y,Cxy] : csp.getConstraints().at(x)) {
+                if (x < y) pairs.push_back(std::make_pair(x,y));
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        // Relations of the tables, each once however many pairs share it. Constraints that
+        // are not extensive yet are extended over the current domains.
+        std::vector<std::shared_ptr<ExtensiveRelation>> relations;
+        std::unordered_map<const ExtensiveRelation*,uint32_t> relationIdx;
+        std::vector<std::pair<uint32_t,uint32_t>> tables; // relation index and side of each pair
+        for (auto [x,y] : pairs) {
+            const Constraint& Cxy = *csp.getConstraints().at(x).at(y);
+            if (dynamic_cast<const DifferenceConstraint*>(&Cxy)) continue;
+            std::unique_ptr<Constraint> extension;
+            const ExtensiveConstraint* table = dynamic_cast<const ExtensiveConstraint*>(&Cxy);
+            if (!table) {
+                extension = Cxy.extensify(csp.getDomain(x), csp.getDomain(y));
+                table = static_cast<const ExtensiveConstraint*>(extension.get());
+            }
+            auto [it, isNew] = relationIdx.emplace(table->getRelation().get(), uint32_t(relations.size()));
+            if (isNew) relations.push_back(table->getRelation());
+            tables.push_back(std::make_pair(it->second, uint32_t(table->getSide())));
+        }
+        payload.putUnsigned(uint32_t(relations.size()));
+        for (const auto& relation : relations) {
+            for (int side=0; side<2; side++) payload.putUnsigned(uint32_t(relation->getValues(side).size()));
+            for (int side=0; side<2; side++) {
+                for (int value : relation->getValues(side)) payload.putInt(value);
+            }
+            for (int side=0; side<2; side++) {
+                const std::vector<uint64_t>& rows = relation->getRows(side);
+                payload.put(rows.data(), rows.size() * sizeof(uint64_t));
+            }
+        }
+
+        payload.putUnsigned(uint32_t(pairs.size()));
+        std::size_t nbTables = 0;
+        for (auto [x,y] : pairs) {
+            const Constraint& Cxy = *csp.getConstraints().at(x).at(y);
+            payload.putInt(x);
+            payload.putInt(y);
+            if (dynamic_cast<const DifferenceConstraint*>(&Cxy)) {
+                payload.putUnsigned(uint32_t(RelationKind::Difference));
+                continue;
+            }
+            payload.putUnsigned(uint32_t(RelationKind::Table));
+            payload.putUnsigned(tables[nbTables].first);
+            payload.putUnsigned(tables[nbTables].second);
+            nbTables++;
+        }
+
+        // All different families
+        const std::vector<std::vector<int>>& families = csp.getAllDifferentFamilies();
+        payload.putUnsigned(uint32_t(families.size()));
+        for (const std::vector<int>& family : families) {
+            payload.putUnsigned(uint32_t(family.size()));
+            for (int var : family) payload.putInt(var);
+        }
+
+        header.payloadSize = payload.size;
+        header.checksum = payload.checksum;
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) throw std::logic_error("Cannot write model file " + path);
+}
+
+void ModelFile::read(const std::string& path, CSP& csp) {
+    MappedFile file(path);
+    Header header;
+    if (file.size() < sizeof(header)) throw std::logic_error("Truncated model file");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::logic_error("Not a model file");
+    if (header.version != VERSION) throw std::logic_error("Unsupported model file version " + std::to_string(header.version));
+    if (header.payloadSize != file.size() - sizeof(header)) throw std::logic_error("Truncated model file");
+    const char* begin = file.data() + sizeof(header);
+    if (fnv1a(FNV_OFFSET, begin, header.payloadSize) != header.checksum) throw std::logic_error("Corrupted model file (bad checksum)");
+
+    PayloadReader payload(begin, header.payloadSize);
+    csp.setProblemType(Problem(header.problemType));
+
+    // Problem
+    csp.setColorLowerBound(payload.get<uint32_t>());
+    const std::vector<char> model = payload.getArray<char>(payload.get<uint32_t>());
+    csp.setModel(std::string(model.begin(), model.end()));
+
+    // Domains
+    uint32_t nbVar = payload.get<uint32_t>();
+    for (uint32_t i=0; i<nbVar; i++) {
+        int var = payload.get<int32_t>();
+        uint32_t domainSize = payload.get<uint32_t>();
+        csp.addVariable(var);
+        for (uint32_t k=0; k<domainSize; k++) csp.addVariableValue(var, payload.get<int32_t>());
+    }
+
+    // Relations, their bit matrices are taken as they are
+    std::vector<std::shared_ptr<ExtensiveRelation>> relations(payload.get<uint32_t>());
+    for (std::shared_ptr<ExtensiveRelation>& relation : relations) {
+        const std::size_t sizeX = payload.get<uint32_t>();
+        const std::size_t sizeY = payload.get<uint32_t>();
+        std::vector<int> valuesX = payload.getArray<int>(sizeX);
+        std::vector<int> valuesY = payload.getArray<int>(sizeY);
+        std::vector<uint64_t> rowsX = payload.getArray<uint64_t>(sizeX * ((sizeY + 63) / 64));
+        std::vector<uint64_t> rowsY = payload.getArray<uint64_t>(sizeY * ((sizeX + 63) / 64));
+        relation = std::make_shared<ExtensiveRelation>(std::move(valuesX), std::move(valuesY), std::move(rowsX), std::move(rowsY));
+    }
+
+    // Constraints
+    uint32_t nbConstr = payload.get<uint32_t>();
+    for (uint32_t i=0; i<nbConstr; i++) {
+        int x = payload.get<int32_t>();
+        int y = payload.get<int32_t>();
+        RelationKind kind = RelationKind(payload.get<uint32_t>());
+        if (kind == RelationKind::Difference) {
+            csp.addDifferenceConstraint(x,y);
+            continue;
+        }
+        if (kind != RelationKind::Table) throw std::logic_error("Unknown relation kind in model file");
+        uint32_t relationIdx = payload.get<uint32_t>();
+        uint32_t side = payload.get<uint32_t>();
+        if (relationIdx >= relations.size() || side > 1) throw std::logic_error("Wrong relation in model file");
+        csp.addConstraint(x, y, relations[relationIdx], int(side));
+    }
+
+    // All different families
+    uint32_t nbFamilies = payload.get<uint32_t>();
+    for (uint32_t i=0; i<nbFamilies; i++) {
+        uint32_t size = payload.get<uint32_t>();
+        std::vector<int> family(size);
+        for (uint32_t k=0; k<size; k++) family[k] = payload.get<int32_t>();
+        csp.addAllDifferentFamily(family);
+    }
+    if (!payload.done()) throw std::logic_error("Trailing data in model file");
+}
@@ -0,0 +1,19 @@
+#ifndef MODEL_FILE_H_
+#define MODEL_FILE_H_
+
+#include <string>
+
+#include "csp.h"
+
+// Versioned and checksummed binary dump of a built csp: domains, constraint
+// graph, relations as the bit matrices of ExtensiveRelation, stored once per
+// relation, and all different families. Loading maps the file and copies the
+// matrices as they are, no text parsing and no pair by pair rebuild.
+class ModelFile {
+public:
+    static bool isModelFile(const std::string& path);
+    static void write(const CSP& csp, const std::string& path);
+    static void read(const std::string& path, CSP& csp);
+};
+
+#endif
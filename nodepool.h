@@ -0,0 +1,60 @@
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <vector>
+
+// Nodes taken out of an unordered set or map, given back to it in place of new ones, so
+// that containers whose elements come and go stop allocating once warm. Copies of a
+// pool start empty, the nodes stay with the original.
+template<typename Container>
+class NodePool {
+
+private:
+    std::vector<typename Container::node_type> nodes;
+
+    void put(typename Container::node_type&& node) {nodes.push_back(std::move(node));}
+
+public:
+    NodePool() {}
+    NodePool(const NodePool&) {}
+    NodePool& operator=(const NodePool&) {return *this;}
+
+    // Erase key from container, keeping its node. False if it was not there.
+    template<typename Key>
+    bool erase(Container& container, const Key& key) {
+        typename Container::node_type node = container.extract(key);
+        if (node.empty()) return false;
+        put(std::move(node));
+        return true;
+    }
+    void clear(Container& container) {
+        while (!container.empty()) put(container.extract(container.begin()));
+    }
+
+    // Insert into a set, false if the value was already there
+    template<typename Value>
+    bool insert(Container& container, const Value& value) {
+        if (nodes.empty()) return container.insert(value).second;
+        typename Container::node_type node = std::move(nodes.back());
+        nodes.pop_back();
+        node.value() = value;
+        auto inserted = container.insert(std::move(node));
+        if (!inserted.inserted) put(std::move(inserted.node));
+        return inserted.inserted;
+    }
+
+    // Insert into a map, false if the key was already there
+    template<typename Key, typename Mapped>
+    bool insert(Container& container, const Key& key, const Mapped& mapped) {
+        if (nodes.empty()) return container.emplace(key, mapped).second;
+        typename Container::node_type node = std::move(nodes.back());
+        nodes.pop_back();
+        node.key() = key;
+        node.mapped() = mapped;
+        auto inserted = container.insert(std::move(node));
+        if (!inserted.inserted) put(std::move(inserted.node));
+        return inserted.inserted;
+    }
+};
+
+#endif
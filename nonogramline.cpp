@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cassert>
+
+#include "nonogramline.h"
+
+NonogramLinePropagator::NonogramLinePropagator(std::vector<int> _cells, const std::vector<unsigned int>& _clues) : cells{_cells} {
+    // An empty line is given by the single clue 0
+    for (unsigned int clue : _clues) {
+        if (clue > 0) clues.push_back(clue);
+    }
+    std::size_t n = cells.size();
+    std::size_t k = clues.size();
+    canWhite.resize(n);
+    canBlack.resize(n);
+    nbNotBlack.resize(n + 1);
+    prefix.resize((k + 1) * (n + 1));
+    suffix.resize((k + 1) * (n + 1));
+    white.resize(n);
+    black.resize(n + 1);
+}
+
+bool NonogramLinePropagator::canHoldBlock(unsigned int start, unsigned int len) const {
+    return nbNotBlack[start + len] == nbNotBlack[start];
+}
+
+bool NonogramLinePropagator::propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove) {
+    const unsigned int n = (unsigned int)(cells.size());
+    const unsigned int k = (unsigned int)(clues.size());
+    const unsigned int stride = n + 1;
+    for (unsigned int p=0; p<n; p++) {
+        const std::unordered_set<int>& domain = domains.at(cells[p]);
+        canWhite[p] = domain.count(0);
+        canBlack[p] = domain.count(1);
+        nbNotBlack[p+1] = nbNotBlack[p] + (canBlack[p] ? 0 : 1);
+    }
+
+    // Left-most placements: prefix[j][i] if the j first blocks fit in [0,i)
+    prefix[0] = true;
+    for (unsigned int i=1; i<=n; i++) prefix[i] = prefix[i-1] && canWhite[i-1];
+    for (unsigned int j=1; j<=k; j++) {
+        const unsigned int len = clues[j-1];
+        for (unsigned int i=0; i<=n; i++) {
+            bool fits = i > 0 && canWhite[i-1] && prefix[j*stride + i-1];
+            if (!fits && i >= len && canHoldBlock(i - len, len)) {
+                unsigned int start = i - len;
+                fits = (start == 0) ? (j == 1) : (canWhite[start-1] && prefix[(j-1)*stride + start-1]);
+            }
+            prefix[j*stride + i] = fits;
+        }
+    }
+    if (!prefix[k*stride + n]) return false;
+
+    // Right-most placements: suffix[j][i] if the blocks from j fit in [i,n)
+    suffix[k*stride + n] = true;
+    for (unsigned int i=n; i-->0;) suffix[k*stride + i] = suffix[k*stride + i+1] && canWhite[i];
+    for (unsigned int j=k; j-->0;) {
+        const unsigned int len = clues[j];
+        for (unsigned int i=n+1; i-->0;) {
+            bool fits = i < n && canWhite[i] && suffix[j*stride + i+1];
+            if (!fits && i + len <= n && canHoldBlock(i, len)) {
+                unsigned int end = i + len;
+                fits = (end == n) ? (j == k-1) : (canWhite[end] && suffix[(j+1)*stride + end+1]);
+            }
+            suffix[j*stride + i] = fits;
+        }
+    }
+
+    // A cell can be white if it separates a prefix and a suffix placement
+    for (unsigned int p=0; p<n; p++) {
+        white[p] = false;
+        if (!canWhite[p]) continue;
+        for (unsigned int j=0; j<=k && !white[p]; j++) {
+            white[p] = prefix[j*stride + p] && suffix[j*stride + p+1];
+        }
+    }
+    // A cell can be black if it is covered by a valid placement of some block
+    std::fill(black.begin(), black.end(), 0);
+    for (unsigned int j=0; j<k; j++) {
+        const unsigned int len = clues[j];
+        for (unsigned int start=0; start+len<=n; start++) {
+            if (!canHoldBlock(start, len)) continue;
+            unsigned int end = start + len;
+            bool left = (start == 0) ? (j == 0) : (canWhite[start-1] && prefix[j*stride + start-1]);
+            if (!left) continue;
+            bool right = (end == n) ? (j == k-1) : (canWhite[end] && suffix[(j+1)*stride + end+1]);
+            if (!right) continue;
+            black[start]++;
+            black[end]--;
+        }
+    }
+
+    int covered = 0;
+    for (unsigned int p=0; p<n; p++) {
+        covered += black[p];
+        if (canWhite[p] && !white[p]) toRemove.push_back(std::make_pair(cells[p], 0));
+        if (canBlack[p] && covered == 0) toRemove.push_back(std::make_pair(cells[p], 1));
+    }
+    return true;
+}
+
+bool NonogramLinePropagator::feasible(const std::unordered_map<int,int>& partSol) const {
+    std::vector<unsigned int> blocks;
+    unsigned int len = 0;
+    for (int cell : cells) {
+        auto it = partSol.find(cell);
+        if (it == partSol.end()) return true; // only complete lines are checked
+        if (it->second == 1) len++;
+        else if (len > 0) {
+            blocks.push_back(len);
+            len = 0;
+        }
+    }
+    if (len > 0) blocks.push_back(len);
+    return blocks == clues;
+}
+
+void NonogramLinePropagator::display() const {
+    std::cout << "Nonogram line of " << cells.size() << " cells:";
+    for (unsigned int clue : clues) std::cout << " " << clue;
+    std::cout << std::endl;
+}
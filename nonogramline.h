@@ -0,0 +1,38 @@
+#ifndef NONOGRAM_LINE_H_
+#define NONOGRAM_LINE_H_
+
+#include "propagator.h"
+
+// Row or column of a nonogram over boolean cell variables. The left-most /
+// right-most placement DP finds every cell value used by some placement of
+// the blocks in O(length x clues).
+class NonogramLinePropagator : public Propagator {
+
+private:
+    std::vector<int> cells;
+    std::vector<unsigned int> clues;
+
+    // Scratch buffers of propagate
+    std::vector<char> canWhite;
+    std::vector<char> canBlack;
+    std::vector<unsigned int> nbNotBlack; // prefix counts of cells that cannot be black
+    std::vector<char> prefix; // prefix[j*(n+1)+i]: cells [0,i) can hold the first j blocks
+    std::vector<char> suffix; // suffix[j*(n+1)+i]: cells [i,n) can hold the blocks from j
+    std::vector<char> white;
+    std::vector<int> black; // difference array of the cells covered by a block placement
+
+    bool canHoldBlock(unsigned int start, unsigned int len) const;
+
+public:
+    NonogramLinePropagator(std::vector<int> _cells, const std::vector<unsigned int>& _clues);
+
+    std::unique_ptr<Propagator> clone() const{return std::make_unique<NonogramLinePropagator>(*this);}
+    const std::vector<int>& getVariables() const{return cells;}
+
+    bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove);
+    bool feasible(const std::unordered_map<int,int>& partSol) const;
+
+    void display() const;
+};
+
+#endif
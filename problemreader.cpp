@@ -1,34 +1,33 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <cmath>
+#include <charconv>
+#include <stdexcept>
+#include <cctype>
+#include <algorithm>
 
 #include "problemreader.h"
+#include "tokenizer.h"
+#include "csp.h"
 
 ColorProblem ProblemReader::readColorProblem(std::string path) {
-    std::ifstream inputFile(path);
+    Tokenizer tokenizer(path);
     ColorProblem problem;
 
-    std::string line;
-    std::string word;
-    std::getline(inputFile, line);
-    while (std::getline(inputFile, line)) {
-        std::stringstream ss(line);
-        ss >> word;
+    tokenizer.nextLine();
+    while (!tokenizer.eof()) {
+        std::string_view word = tokenizer.word();
         if (word == "p") {
-            ss >> word;
-            ss >> word;
-            problem.nb_nodes = std::stoi(word);
-            ss >> word;
-            problem.nb_edges = std::stoi(word);
+            tokenizer.word();
+            problem.nb_nodes = tokenizer.readInt();
+            problem.nb_edges = tokenizer.readInt();
+            problem.edges.reserve((std::size_t)(problem.nb_edges));
         } else if (word == "e") {
-            ss >> word;
-            int i = std::stoi(word);
-            ss >> word;
-            int j = std::stoi(word);
+            int i = tokenizer.readInt();
+            int j = tokenizer.readInt();
             problem.edges.push_back(std::make_pair(i,j));
         }
+        tokenizer.nextLine();
     }
 
     int nbColors = problem.nb_nodes;
@@ -48,133 +47,179 @@ ColorProblem ProblemReader::readColorProblem(std::string path) {
     return problem;
 }
 
-SudokuProblem ProblemReader::readSudokuProblem(std::string path) {
-    unsigned int n = 9;
-    std::ifstream inputFile(path);
+// Cell of the one character per cell encoding: 0 or . if empty, then 1-9, A-Z, a-z
+static int sudokuCellValue(char c) {
+    if (c == '0' || c == '.') return 0;
+    if (c >= '1' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'z') return c - 'a' + 36;
+    throw std::logic_error(std::string("Wrong sudoku cell ") + c);
+}
+
+// Side of a n² x n² grid with this number of cells, 0 if there is none
+static unsigned int sudokuSide(std::size_t nbCells) {
+    unsigned int side = (unsigned int)(std::lround(std::sqrt(double(nbCells))));
+    unsigned int block = (unsigned int)(std::lround(std::sqrt(double(side))));
+    if (std::size_t(side) * side != nbCells || block * block != side || block < 2) return 0;
+    return side;
+}
+
+// Grid of the cells read row by row
+static SudokuProblem sudokuGrid(const std::vector<int>& cells) {
     SudokuProblem problem;
+    unsigned int n = sudokuSide(cells.size());
+    if (n == 0) throw std::logic_error("Sudoku grid is not n² x n²: " + std::to_string(cells.size()) + " cells");
     problem.n = n;
-    
-    std::string line;
-    std::getline(inputFile, line);
-    std::getline(inputFile, line);
     for (unsigned int i=0; i<n; i++) {
         problem.grid.push_back(std::vector<int>());
         for (unsigned int j=0; j<n; j++) {
-            problem.grid.back().push_back(line[n*i+j]-'0');
+            int value = cells[n*i+j];
+            if (value < 0 || value > int(n)) throw std::logic_error("Sudoku value out of range: " + std::to_string(value));
+            problem.grid.back().push_back(value);
         }
     }
     return problem;
 }
 
+// Whitespace separated integers of a line
+static std::vector<int> lineInts(std::string_view line) {
+    std::vector<int> values;
+    const char* it = line.data();
+    const char* end = line.data() + line.size();
+    while (true) {
+        while (it != end && std::isspace((unsigned char)(*it))) it++;
+        if (it == end) return values;
+        int value = 0;
+        auto [next, ec] = std::from_chars(it, end, value);
+        if (ec != std::errc()) throw std::logic_error("Expected an integer in line: " + std::string(line));
+        values.push_back(value);
+        it = next;
+    }
+}
+
+SudokuProblem ProblemReader::readSudokuProblem(std::string path) {
+    Tokenizer tokenizer(path);
+    std::vector<int> cells;
+
+    // Either a single line with one character per cell or whitespace separated integers
+    tokenizer.nextLine();
+    std::string_view first = tokenizer.word();
+    if (tokenizer.eol() && sudokuSide(first.size()) > 0) {
+        for (char c : first) cells.push_back(sudokuCellValue(c));
+    } else {
+        int value = 0;
+        if (std::from_chars(first.data(), first.data() + first.size(), value).ec != std::errc()) throw std::logic_error("Expected an integer in sudoku grid");
+        cells.push_back(value);
+        while (!tokenizer.eof()) {
+            while (tokenizer.nextInt(value)) cells.push_back(value);
+            tokenizer.nextLine();
+        }
+    }
+    return sudokuGrid(cells);
+}
+
+SudokuProblem ProblemReader::readSudokuLine(std::string_view line) {
+    std::size_t first = line.find_first_not_of(" \t\r");
+    std::size_t last = line.find_last_not_of(" \t\r");
+    if (first == std::string_view::npos) throw std::logic_error("Empty sudoku line");
+    std::string_view trimmed = line.substr(first, last - first + 1);
+    if (trimmed.find_first_of(" \t") != std::string_view::npos) return sudokuGrid(lineInts(trimmed));
+    std::vector<int> cells;
+    for (char c : trimmed) cells.push_back(sudokuCellValue(c));
+    return sudokuGrid(cells);
+}
+
 QueenProblem ProblemReader::readQueenProblem(std::string path) {
-    std::ifstream inputFile(path);
+    Tokenizer tokenizer(path);
     QueenProblem problem;
 
-    std::string line;
-    std::getline(inputFile, line);
-    std::getline(inputFile, line);
-    problem.nb_queens = std::stoi(line);
+    tokenizer.nextLine();
+    problem.nb_queens = tokenizer.readInt();
     return problem;
 }
 
 BlockedQueenProblem ProblemReader::readBlockedQueenProblem(std::string path) {
-    std::ifstream inputFile(path);
+    Tokenizer tokenizer(path);
     BlockedQueenProblem problem;
 
-    std::string line;
-    std::getline(inputFile, line);
-    std::getline(inputFile, line);
-    problem.nb_queens = std::stoi(line);
-    std::string word;
-    while (std::getline(inputFile, line)) {
-        std::stringstream ss(line);
-        ss >> word;
-        int i = std::stoi(word);
-        ss >> word;
-        int j = std::stoi(word);
-        problem.blockedSquares.push_back(std::make_pair(i,j));
+    tokenizer.nextLine();
+    problem.nb_queens = tokenizer.readInt();
+    tokenizer.nextLine();
+    while (!tokenizer.eof()) {
+        int i;
+        if (tokenizer.nextInt(i)) {
+            int j = tokenizer.readInt();
+            problem.blockedSquares.push_back(std::make_pair(i,j));
+        }
+        tokenizer.nextLine();
+    }
+    return problem;
+}
+
+BlockedQueenProblem ProblemReader::readBlockedQueenLine(std::string_view line) {
+    std::vector<int> values = lineInts(line);
+    if (values.empty() || values.size() % 2 == 0) throw std::logic_error("Expected the number of queens then blocked squares i j: " + std::string(line));
+    BlockedQueenProblem problem;
+    problem.nb_queens = values[0];
+    for (std::size_t k=1; k<values.size(); k+=2) {
+        problem.blockedSquares.push_back(std::make_pair(values[k], values[k+1]));
     }
     return problem;
 }
 
 NonogramProblem ProblemReader::readNonogramProblem(std::string path) {
-    std::ifstream inputFile(path);
+    Tokenizer tokenizer(path);
     NonogramProblem problem;
 
-    std::string line;
-    std::string word;
-    std::stringstream ss;
-    std::getline(inputFile, line);
-    std::getline(inputFile, line);
-    ss = std::stringstream(line);
-    ss >> word;
-    problem.w = std::stoul(word);
-    ss >> word;
-    problem.h = std::stoul(word);
+    tokenizer.nextLine();
+    problem.w = tokenizer.readUnsigned();
+    problem.h = tokenizer.readUnsigned();
+    tokenizer.nextLine();
 
+    int clue;
     for (unsigned int i=0; i<problem.w; i++) {
-        std::getline(inputFile, line);
-        ss = std::stringstream(line);
         problem.verticalClues.push_back(std::vector<unsigned int>());
-
-        while (ss >> word) {
-            problem.verticalClues.back().push_back(std::stoul(word));
+        while (tokenizer.nextInt(clue)) {
+            problem.verticalClues.back().push_back((unsigned int)(clue));
         }
+        tokenizer.nextLine();
     }
 
     for (unsigned int j=0; j<problem.h; j++) {
-        std::getline(inputFile, line);
-        ss = std::stringstream(line);
         problem.horizontalClues.push_back(std::vector<unsigned int>());
-        
-        while (ss >> word) {
-            problem.horizontalClues.back().push_back(std::stoul(word));
+        while (tokenizer.nextInt(clue)) {
+            problem.horizontalClues.back().push_back((unsigned int)(clue));
         }
+        tokenizer.nextLine();
     }
     return problem;
 }
 
-GenericProblem ProblemReader::readGenericProblem(std::string path) {
-    std::ifstream inputFile(path);
-    GenericProblem problem;
-
-    std::string line;
-    std::string word;
-    std::stringstream ss;
-    std::getline(inputFile, line);
-    std::getline(inputFile, line);
-    ss = std::stringstream(line);
-    ss >> word;
-    problem.nbVar = std::stoul(word);
-    ss >> word;
-    problem.nbConstr = std::stoul(word);
-    problem.variables = std::vector<int>(problem.nbVar);
-    problem.domains = std::vector<std::vector<int>>(problem.nbVar);
-    problem.constrVar = std::vector<std::pair<int, int>>(problem.nbConstr);
-    problem.constrVal = std::vector<std::vector<std::pair<int, int>>>(problem.nbConstr);
-    for (unsigned int i=0; i<problem.nbVar; i++) {
-        std::getline(inputFile, line);
-        ss = std::stringstream(line);
-        ss >> word;
-        problem.variables[i] = std::stoi(word);
-        while (ss >> word) {
-            problem.domains[i].push_back(std::stoi(word));
+void ProblemReader::readGenericProblem(std::string path, CSP& csp) {
+    Tokenizer tokenizer(path);
+
+    tokenizer.nextLine();
+    unsigned int nbVar = tokenizer.readUnsigned();
+    unsigned int nbConstr = tokenizer.readUnsigned();
+    tokenizer.nextLine();
+
+    int value;
+    for (unsigned int i=0; i<nbVar; i++) {
+        int var = tokenizer.readInt();
+        csp.addVariable(var);
+        while (tokenizer.nextInt(value)) {
+            csp.addVariableValue(var,value);
         }
+        tokenizer.nextLine();
     }
-    for (unsigned int i=0; i<problem.nbConstr; i++) {
-        std::getline(inputFile, line);
-        ss = std::stringstream(line);
-        ss >> word;
-        int var1 = std::stoi(word);
-        ss >> word;
-        int var2 = std::stoi(word);
-        problem.constrVar[i] = std::make_pair(var1,var2);
-        while (ss >> word) {
-            int val1 = std::stoi(word);
-            ss >> word;
-            int val2 = std::stoi(word);
-            problem.constrVal[i].push_back(std::make_pair(val1,val2));
+    for (unsigned int i=0; i<nbConstr; i++) {
+        int var1 = tokenizer.readInt();
+        int var2 = tokenizer.readInt();
+        csp.addConstraint(var1,var2);
+        while (tokenizer.nextInt(value)) {
+            int val2 = tokenizer.readInt();
+            csp.addConstraintValuePair(var1,var2,value,val2);
         }
+        tokenizer.nextLine();
     }
-    return problem;
-}
\ No newline at end of file
+}
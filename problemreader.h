@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include "instances.h"
 
+class CSP;
+
 class ProblemReader {
 public:
     static ColorProblem readColorProblem(std::string path);
@@ -13,7 +16,12 @@ public:
     static QueenProblem readQueenProblem(std::string path);
     static BlockedQueenProblem readBlockedQueenProblem(std::string path);
     static NonogramProblem readNonogramProblem(std::string path);
-    static GenericProblem readGenericProblem(std::string path);
+    // One instance per line, for batch solving: a sudoku grid in either encoding,
+    // or the number of queens followed by the blocked squares i j
+    static SudokuProblem readSudokuLine(std::string_view line);
+    static BlockedQueenProblem readBlockedQueenLine(std::string_view line);
+    // Stream variables and tuples straight into the csp
+    static void readGenericProblem(std::string path, CSP& csp);
 };
 
 #endif
\ No newline at end of file
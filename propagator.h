@@ -0,0 +1,33 @@
+#ifndef PROPAGATOR_H_
+#define PROPAGATOR_H_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+
+// Global constraint filtering the domains of its variables as a whole, run by
+// the solver whenever one of its variables loses a value
+class Propagator {
+
+public:
+    virtual ~Propagator(){}
+
+    // Copy with its own scratch state, one per solver
+    virtual std::unique_ptr<Propagator> clone() const=0;
+
+    virtual const std::vector<int>& getVariables() const=0;
+
+    // Append to toRemove the values of the domains that belong to no solution of the
+    // constraint, return false if the constraint has no solution
+    virtual bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove)=0;
+    // Same, knowing that only the variables of changed lost values since the last call at this
+    // node. Propagators filtering from scratch ignore them.
+    virtual bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, const std::vector<int>&, std::vector<std::pair<int,int>>& toRemove) {return propagate(domains, toRemove);}
+
+    virtual bool feasible(const std::unordered_map<int,int>& partSol) const=0;
+
+    virtual void display() const=0;
+};
+
+#endif
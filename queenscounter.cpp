@@ -0,0 +1,79 @@
+#include <thread>
+#include <cassert>
+#include <stdexcept>
+
+#include "queenscounter.h"
+
+// Nodes between two checks of the time limit
+static const unsigned long CHECK_PERIOD = 1 << 16;
+
+QueensCounter::QueensCounter(int _n) : n{_n} {
+    if (n < 1 || n > MAX_QUEENS) throw std::logic_error("Bitboard counting needs between 1 and 64 queens");
+    board = (n == 64) ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+
+    // First queen in the left half, or in the middle column with the second one in the left half
+    auto addTasks = [this](int firstColumn, int secondColumnEnd, unsigned long long weight) {
+        uint64_t first = uint64_t(1) << firstColumn;
+        if (n == 1) {
+            tasks.push_back(Task{first, first << 1, first >> 1, weight});
+            return;
+        }
+        uint64_t attacked = first | (first << 1) | (first >> 1);
+        for (int secondColumn=0; secondColumn<secondColumnEnd; secondColumn++) {
+            uint64_t second = uint64_t(1) << secondColumn;
+            if (attacked & second) continue;
+            tasks.push_back(Task{first | second, (((first << 1) | second) << 1) & board, ((first >> 1) | second) >> 1, weight});
+        }
+    };
+    for (int column=0; column<n/2; column++) addTasks(column, n, 2);
+    if (n % 2 == 1) addTasks(n/2, n/2, n == 1 ? 1 : 2);
+}
+
+void QueensCounter::countFrom(uint64_t columns, uint64_t diagonals, uint64_t antiDiagonals, unsigned long long weight, Worker& worker) {
+    if (columns == board) {
+        worker.solutions += weight;
+        if (limit != UINT64_MAX) flush(worker);
+        return;
+    }
+    if (++worker.nodes % CHECK_PERIOD == 0 && std::chrono::steady_clock::now() >= deadline) stop = true;
+    if (stop.load(std::memory_order_relaxed)) return;
+    uint64_t free = board & ~(columns | diagonals | antiDiagonals);
+    while (free) {
+        uint64_t queen = free & (~free + 1);
+        free ^= queen;
+        countFrom(columns | queen, ((diagonals | queen) << 1) & board, (antiDiagonals | queen) >> 1, weight, worker);
+    }
+}
+
+void QueensCounter::flush(Worker& worker) {
+    if (worker.solutions == 0) return;
+    if ((nbSolutions += worker.solutions) >= limit) stop = true;
+    worker.solutions = 0;
+}
+
+void QueensCounter::work(std::atomic<std::size_t>& next) {
+    Worker worker;
+    for (std::size_t idx=next++; idx<tasks.size() && !stop; idx=next++) {
+        const Task& task = tasks[idx];
+        countFrom(task.columns, task.diagonals, task.antiDiagonals, task.weight, worker);
+    }
+    flush(worker);
+    nbNodes += worker.nodes;
+}
+
+unsigned long long QueensCounter::count(unsigned long long _limit, unsigned int nbThreads, int timeLimit) {
+    limit = _limit;
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeLimit);
+    nbSolutions = 0;
+    nbNodes = 0;
+    stop = (limit == 0);
+
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> threads;
+    for (unsigned int t=1; t<nbThreads; t++) {
+        threads.emplace_back(&QueensCounter::work, this, std::ref(next));
+    }
+    work(next);
+    for (auto& t : threads) t.join();
+    return std::min<unsigned long long>(nbSolutions, limit);
+}
@@ -0,0 +1,56 @@
+#ifndef QUEENS_COUNTER_H_
+#define QUEENS_COUNTER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Count the solutions of the n-queens problem without building them, with bitboards
+// of the attacked columns and diagonals. Solutions whose first queen is in the right
+// half are the mirrors of those in the left half and are not searched. The placements
+// of the first two rows are shared between threads.
+class QueensCounter {
+
+private:
+    struct Task {
+        uint64_t columns;
+        uint64_t diagonals;
+        uint64_t antiDiagonals;
+        unsigned long long weight; // 2 if the mirrored solutions are not searched
+    };
+
+    int n;
+    uint64_t board;
+    std::vector<Task> tasks;
+
+    unsigned long long limit=0;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<unsigned long long> nbSolutions{0};
+    std::atomic<unsigned long> nbNodes{0};
+    std::atomic<bool> stop{false};
+
+    // Counters of a thread, added to the shared ones at the end or at each solution if counting is limited
+    struct Worker {
+        unsigned long nodes=0;
+        unsigned long long solutions=0;
+    };
+
+    // Count the solutions below the given attacked squares
+    void countFrom(uint64_t columns, uint64_t diagonals, uint64_t antiDiagonals, unsigned long long weight, Worker& worker);
+    void flush(Worker& worker);
+    void work(std::atomic<std::size_t>& next);
+
+public:
+    static const int MAX_QUEENS = 64;
+
+    QueensCounter(int _n);
+
+    // Number of solutions, stopped once limit is reached or after timeLimit seconds
+    unsigned long long count(unsigned long long _limit, unsigned int nbThreads, int timeLimit);
+    unsigned long getNbNodes() const{return nbNodes;}
+    // False if the count stopped on the limit or the time limit
+    bool isComplete() const{return !stop;}
+};
+
+#endif
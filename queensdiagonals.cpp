@@ -0,0 +1,90 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <numeric>
+
+#include "queensdiagonals.h"
+
+QueensDiagonalsPropagator::QueensDiagonalsPropagator(int n) {
+    rows.resize((std::size_t)(n));
+    std::iota(rows.begin(), rows.end(), 0);
+    isDone.assign(rows.size(), false);
+    removed.resize(rows.size());
+}
+
+int QueensDiagonalsPropagator::remainingValue(const std::unordered_set<int>& domain, int row) const {
+    const std::vector<int>& rowRemoved = removed[(std::size_t)(row)];
+    for (int value : domain) {
+        if (std::find(rowRemoved.begin(), rowRemoved.end(), value) == rowRemoved.end()) return value;
+    }
+    assert(false);
+    return -1;
+}
+
+bool QueensDiagonalsPropagator::removeValue(const std::unordered_map<int,std::unordered_set<int>>& domains, int row, int value, std::vector<std::pair<int,int>>& toRemove) {
+    const std::unordered_set<int>& domain = domains.at(row);
+    if (!domain.count(value)) return true;
+    std::vector<int>& rowRemoved = removed[(std::size_t)(row)];
+    if (std::find(rowRemoved.begin(), rowRemoved.end(), value) != rowRemoved.end()) return true;
+    if (rowRemoved.empty()) touched.push_back(row);
+    rowRemoved.push_back(value);
+    toRemove.push_back(std::make_pair(row, value));
+    std::size_t nbLeft = domain.size() - rowRemoved.size();
+    if (nbLeft == 0) return false;
+    if (nbLeft == 1) newQueens.push_back(row);
+    return true;
+}
+
+bool QueensDiagonalsPropagator::propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove) {
+    return propagate(domains, rows, toRemove);
+}
+
+bool QueensDiagonalsPropagator::propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, const std::vector<int>& changed, std::vector<std::pair<int,int>>& toRemove) {
+    const int n = int(rows.size());
+    newQueens.clear();
+    for (int row : changed) {
+        if (domains.at(row).size() == 1) newQueens.push_back(row);
+    }
+
+    bool consistent = true;
+    while (consistent && !newQueens.empty()) {
+        int i = newQueens.back();
+        newQueens.pop_back();
+        if (isDone[(std::size_t)(i)]) continue;
+        isDone[(std::size_t)(i)] = true;
+        touched.push_back(i);
+        int a = remainingValue(domains.at(i), i);
+        for (int j=0; j<n && consistent; j++) {
+            if (j == i) continue;
+            consistent = removeValue(domains, j, a, toRemove)
+                      && (a + j - i < 0 || a + j - i >= n || removeValue(domains, j, a + j - i, toRemove))
+                      && (a - j + i < 0 || a - j + i >= n || removeValue(domains, j, a - j + i, toRemove));
+        }
+    }
+
+    for (int row : touched) {
+        isDone[(std::size_t)(row)] = false;
+        removed[(std::size_t)(row)].clear();
+    }
+    touched.clear();
+    return consistent;
+}
+
+bool QueensDiagonalsPropagator::feasible(const std::unordered_map<int,int>& partSol) const {
+    const std::size_t n = rows.size();
+    std::vector<char> columns(n, false), diagonals(2 * n, false), antiDiagonals(2 * n, false);
+    for (int row : rows) {
+        auto it = partSol.find(row);
+        if (it == partSol.end()) continue;
+        std::size_t column = (std::size_t)(it->second);
+        std::size_t diagonal = column + (std::size_t)(row);
+        std::size_t antiDiagonal = column + n - (std::size_t)(row);
+        if (columns[column] || diagonals[diagonal] || antiDiagonals[antiDiagonal]) return false;
+        columns[column] = diagonals[diagonal] = antiDiagonals[antiDiagonal] = true;
+    }
+    return true;
+}
+
+void QueensDiagonalsPropagator::display() const {
+    std::cout << "Queens diagonals: " << rows.size() << " rows" << std::endl;
+}
@@ -0,0 +1,39 @@
+#ifndef QUEENS_DIAGONALS_H_
+#define QUEENS_DIAGONALS_H_
+
+#include "propagator.h"
+
+// Columns x_i, diagonals x_i+i and anti-diagonals x_i-i of n queens all different,
+// where variable i is the column of the queen of row i. Each newly fixed queen
+// removes the three values it attacks from the other rows, O(n) per queen.
+class QueensDiagonalsPropagator : public Propagator {
+
+private:
+    std::vector<int> rows;
+
+    // Scratch buffers of propagate, indexed by row
+    std::vector<char> isDone; // queens whose attacks were removed during this call
+    std::vector<std::vector<int>> removed; // values of toRemove
+    std::vector<int> touched;
+    std::vector<int> newQueens;
+
+    // Remove value from row, push the row to newQueens if a single value is left,
+    // return false if none is left
+    bool removeValue(const std::unordered_map<int,std::unordered_set<int>>& domains, int row, int value, std::vector<std::pair<int,int>>& toRemove);
+    // Value of row not in removed, the row having a single one
+    int remainingValue(const std::unordered_set<int>& domain, int row) const;
+
+public:
+    QueensDiagonalsPropagator(int n);
+
+    std::unique_ptr<Propagator> clone() const{return std::make_unique<QueensDiagonalsPropagator>(*this);}
+    const std::vector<int>& getVariables() const{return rows;}
+
+    bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove);
+    bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, const std::vector<int>& changed, std::vector<std::pair<int,int>>& toRemove);
+    bool feasible(const std::unordered_map<int,int>& partSol) const;
+
+    void display() const;
+};
+
+#endif
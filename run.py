@@ -5,16 +5,67 @@ if __name__ == "__main__":
     parser.add_argument('-f', '--file', type=str, required=True)
     parser.add_argument('-rootSolve', '--rootSolveMethod', choices=['LP', 'FC', 'AC4', 'AC3'], type=str, default='LP')
     parser.add_argument('-nodeSolve', '--nodeSolveMethod', choices=['LP', 'FC', 'AC4', 'AC3'], type=str, default='LP')
-    parser.add_argument('-var', '--varChooser', choices=['random', 'smallest', 'max'], type=str, default='random')
-    parser.add_argument('-val', '--valChooser', choices=['random', 'smallest', 'copy'], type=str, default='random')
+    parser.add_argument('-var', '--varChooser', choices=['random', 'smallest', 'max', 'dsatur'], type=str, default='random')
+    parser.add_argument('-val', '--valChooser', choices=['random', 'smallest', 'copy', 'lcv'], type=str, default='random')
     parser.add_argument('-t', '--timeLimit', type=str, default='-1')
     parser.add_argument('-seed', '--randomSeed', type=str, default='')
     parser.add_argument('-v', '--verbosity', choices=['0', '1'], type=str, default='1')
     parser.add_argument('-nSol', '--nbSolution', type=str, default='1')
     parser.add_argument('-showSol', '--showSolution', choices=['0', '1'], type=str, default='0')
     parser.add_argument('-allDiff', '--AllDifferent', choices=['0', '1'], type=str, default='1')
+    parser.add_argument('-budget', '--extensionBudget', type=str, default='')
+    parser.add_argument('-dump', '--dumpModel', type=str, default='')
+    parser.add_argument('-dumpStage', '--dumpStage', choices=['init', 'extensify', 'presolve'], type=str, default='init')
+    parser.add_argument('-model', '--model', choices=['line', 'units', 'diagonals'], type=str, default='')
+    parser.add_argument('-batch', '--batch', choices=['sudoku', 'blocked_queens'], type=str, default='')
+    parser.add_argument('-threads', '--threads', type=str, default='')
+    parser.add_argument('-count', '--countOnly', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-optimize', '--optimize', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-symmetry', '--colorSymmetry', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-sac', '--singletonConsistency', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-sacTime', '--singletonTimeLimit', type=str, default='')
+    parser.add_argument('-components', '--components', choices=['none', 'root', 'nodes'], type=str, default='none')
+    parser.add_argument('-peel', '--peelTrees', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-btd', '--treeDecomposition', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-btdMemory', '--goodsMemory', type=str, default='')
+    parser.add_argument('-o', '--output', type=str, default='')
+    parser.add_argument('-stream', '--stream', choices=['0', '1'], type=str, default='0')
+    parser.add_argument('-outputFormat', '--outputFormat', choices=['text', 'binary'], type=str, default='text')
     args = parser.parse_args()
-    result = subprocess.Popen(['./run.exe', args.file,  args.rootSolveMethod, args.nodeSolveMethod,  args.varChooser,  args.valChooser,  args.verbosity, args.timeLimit, args.randomSeed, args.nbSolution, args.AllDifferent, args.showSolution, "0", "0"], stdout=subprocess.PIPE, text=True)
+    options = []
+    if args.extensionBudget:
+        options += ['extensionBudget=' + args.extensionBudget]
+    if args.model:
+        options += ['model=' + args.model]
+    if args.batch:
+        options += ['batch=' + args.batch]
+    if args.threads:
+        options += ['threads=' + args.threads]
+    if args.countOnly == '1':
+        options += ['count=1']
+    if args.optimize == '1':
+        options += ['optimize=1']
+    if args.colorSymmetry == '1':
+        options += ['symmetry=1']
+    if args.singletonConsistency == '1':
+        options += ['sac=1']
+    if args.singletonTimeLimit:
+        options += ['sacTime=' + args.singletonTimeLimit]
+    if args.components != 'none':
+        options += ['components=' + args.components]
+    if args.peelTrees == '1':
+        options += ['peel=1']
+    if args.treeDecomposition == '1':
+        options += ['btd=1']
+    if args.goodsMemory:
+        options += ['btdMemory=' + args.goodsMemory]
+    if args.output:
+        options += ['output=' + args.output, 'outputFormat=' + args.outputFormat]
+    if args.stream == '1':
+        options += ['stream=1']
+    if args.dumpModel:
+        options += ['dump=' + args.dumpModel, 'dumpStage=' + args.dumpStage]
+    result = subprocess.Popen(['./run.exe', args.file,  args.rootSolveMethod, args.nodeSolveMethod,  args.varChooser,  args.valChooser,  args.verbosity, args.timeLimit, args.randomSeed, args.nbSolution, args.AllDifferent, args.showSolution, "0", "0"] + options, stdout=subprocess.PIPE, text=True)
 
     for line in iter(result.stdout.readline, ''):
         line = line.replace('\r', '').replace('\n', '')
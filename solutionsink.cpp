@@ -0,0 +1,50 @@
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+
+#include "solutionsink.h"
+
+SolutionWriter::SolutionWriter(const std::string& path, Format _format) : format{_format} {
+    file.open(path, format == Format::Binary ? std::ios::out | std::ios::binary : std::ios::out);
+    if (!file.is_open()) throw std::logic_error("Cannot open the solution file " + path);
+    buffer.reserve(BUFFER_SIZE);
+}
+
+SolutionWriter::~SolutionWriter() {
+    flush();
+}
+
+void SolutionWriter::writeInt(int value) {
+    if (format == Format::Binary) {
+        int32_t word = int32_t(value);
+        buffer.append(reinterpret_cast<const char*>(&word), sizeof(word));
+        return;
+    }
+    char digits[16];
+    buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+void SolutionWriter::flush() {
+    file.write(buffer.data(), std::streamsize(buffer.size()));
+    file.flush();
+    buffer.clear();
+}
+
+void SolutionWriter::begin(const std::vector<int>& variables) {
+    if (format == Format::Binary) writeInt(int(variables.size()));
+    else buffer += "#";
+    for (int var : variables) {
+        if (format == Format::Text) buffer += ' ';
+        writeInt(var);
+    }
+    if (format == Format::Text) buffer += '\n';
+}
+
+void SolutionWriter::add(const std::vector<int>& values) {
+    for (std::size_t i=0; i<values.size(); i++) {
+        if (format == Format::Text && i > 0) buffer += ' ';
+        writeInt(values[i]);
+    }
+    if (format == Format::Text) buffer += '\n';
+    if (buffer.size() >= BUFFER_SIZE) flush();
+}
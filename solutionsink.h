@@ -0,0 +1,77 @@
+#ifndef SOLUTION_SINK_H_
+#define SOLUTION_SINK_H_
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Receives the solutions of a solver one at a time instead of keeping them. Values are
+// given as a dense array, in the order of the variables given to begin().
+class SolutionSink {
+
+public:
+    virtual ~SolutionSink(){}
+
+    virtual void begin(const std::vector<int>&) {}
+    virtual void add(const std::vector<int>& values)=0;
+    virtual void end() {}
+    // Sinks which ignore the values save the solver from building them
+    virtual bool needsValues() const {return true;}
+};
+
+// Only counts the solutions
+class CountSink : public SolutionSink {
+
+private:
+    unsigned long long count=0;
+
+public:
+    void add(const std::vector<int>&) {count++;}
+    bool needsValues() const {return false;}
+    unsigned long long getCount() const {return count;}
+};
+
+// Writes the solutions to a file through a buffer. The text format starts with a line
+// "# x1 x2 ..." of the variables, then has one line of values per solution. The binary
+// format starts with the number of variables and the variables, then has the values of
+// each solution, all as native 32 bit integers.
+class SolutionWriter : public SolutionSink {
+
+public:
+    enum class Format {Text, Binary};
+
+private:
+    std::ofstream file;
+    Format format;
+    std::string buffer;
+
+    static const std::size_t BUFFER_SIZE = std::size_t(1) << 20;
+
+    void writeInt(int value);
+    void flush();
+
+public:
+    SolutionWriter(const std::string& path, Format _format);
+    ~SolutionWriter();
+
+    void begin(const std::vector<int>& variables);
+    void add(const std::vector<int>& values);
+    void end() {flush();}
+};
+
+// Passes each solution to a function of the variables and their values
+class CallbackSink : public SolutionSink {
+
+private:
+    std::function<void(const std::vector<int>&, const std::vector<int>&)> callback;
+    std::vector<int> variables;
+
+public:
+    explicit CallbackSink(std::function<void(const std::vector<int>&, const std::vector<int>&)> _callback) : callback(std::move(_callback)) {}
+
+    void begin(const std::vector<int>& _variables) {variables = _variables;}
+    void add(const std::vector<int>& values) {callback(variables, values);}
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <climits>
+#include <stdexcept>
+#include <utility>
+
+#include "solutionstream.h"
+#include "solver.h"
+
+// Hands the solutions of the search over to the stream
+class SolutionStream::StreamSink : public SolutionSink {
+
+private:
+    SolutionStream& stream;
+    std::vector<int> variables;
+    std::unordered_map<int,int> solution;
+
+public:
+    explicit StreamSink(SolutionStream& _stream) : stream{_stream} {}
+
+    void begin(const std::vector<int>& _variables) {
+        variables = _variables;
+        solution.reserve(variables.size());
+    }
+    void add(const std::vector<int>& values) {
+        for (std::size_t i=0; i<variables.size(); i++) solution[variables[i]] = values[i];
+        // The search thread stops itself, the consumer never writes to the solver
+        if (!stream.deliver(solution)) stream.solver.stop();
+    }
+};
+
+SolutionStream::SolutionStream(Solver& _solver) : solver{_solver} {
+    if (solver.isCountOnly()) throw std::logic_error("Counting does not build the solutions to stream");
+    // The consumer decides when to stop
+    solver.setNbSolutions(INT_MAX);
+    solver.setSolutionSink(std::make_unique<StreamSink>(*this));
+}
+
+SolutionStream::~SolutionStream() {
+    if (started) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+        search.join();
+    }
+    solver.setSolutionSink(nullptr);
+}
+
+bool SolutionStream::deliver(const std::unordered_map<int,int>& _solution) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (closed) return false;
+    solution = _solution;
+    hasSolution = true;
+    changed.notify_all();
+    changed.wait(lock, [this]{return !hasSolution || closed;});
+    return !closed;
+}
+
+bool SolutionStream::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!started) {
+        started = true;
+        search = std::thread([this]() {
+            std::exception_ptr thrown;
+            try {
+                solver.solve();
+            } catch (...) {
+                thrown = std::current_exception();
+            }
+            std::lock_guard<std::mutex> finishedLock(mutex);
+            error = thrown;
+            finished = true;
+            changed.notify_all();
+        });
+    } else if (hasSolution) {
+        // Release the search waiting on the consumed solution
+        hasSolution = false;
+        changed.notify_all();
+    }
+    changed.wait(lock, [this]{return hasSolution || finished;});
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+    return hasSolution;
+}
@@ -0,0 +1,77 @@
+#ifndef SOLUTION_STREAM_H_
+#define SOLUTION_STREAM_H_
+
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+class Solver;
+
+// Pulls the solutions of a solver one at a time. The search runs in its own thread and
+// waits in the solution sink until the next solution is asked for, so it resumes where
+// it stopped. Leaving the stream early stops the search.
+class SolutionStream {
+
+public:
+    class Iterator {
+
+    private:
+        SolutionStream* stream;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::unordered_map<int,int>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        explicit Iterator(SolutionStream* _stream) : stream{_stream} {}
+
+        reference operator*() const {return stream->current();}
+        pointer operator->() const {return &stream->current();}
+        Iterator& operator++() {
+            if (!stream->next()) stream = nullptr;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {return stream == other.stream;}
+        bool operator!=(const Iterator& other) const {return stream != other.stream;}
+    };
+
+private:
+    class StreamSink;
+
+    Solver& solver;
+    std::thread search;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // The search holds a solution until it is consumed, and is released when closed
+    bool started=false;
+    bool hasSolution=false;
+    bool finished=false;
+    bool closed=false;
+    std::unordered_map<int,int> solution;
+    // Thrown by the search, rethrown to the consumer
+    std::exception_ptr error;
+
+    // Wait until the solution is consumed, false once the stream is closed
+    bool deliver(const std::unordered_map<int,int>& _solution);
+
+public:
+    explicit SolutionStream(Solver& _solver);
+    ~SolutionStream();
+    SolutionStream(const SolutionStream&) = delete;
+    SolutionStream& operator=(const SolutionStream&) = delete;
+
+    // Resume the search until the next solution, false once the search is over.
+    // Rethrows what the search threw.
+    bool next();
+    const std::unordered_map<int,int>& current() const {return solution;}
+
+    Iterator begin() {return Iterator(next() ? this : nullptr);}
+    Iterator end() {return Iterator(nullptr);}
+};
+
+#endif
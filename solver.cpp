@@ -1,16 +1,24 @@
 #include "solver.h"
+#include "modelfile.h"
+#include "queenscounter.h"
 #include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
-Solver::Solver(CSP _problem, const std::vector<std::string> _parameters, bool _verbosity) : problem(_problem), parameters(_parameters), verbosity(_verbosity) {
+Solver::Solver(const CSP& _problem, const std::vector<std::string> _parameters, bool _verbosity) : problem(_problem), parameters(_parameters), verbosity(_verbosity) {
     unsetVariables = problem.getVariables();
     translateParameters(parameters);
     initAllDifferent();
+    initPropagators();
 }
 
-Solver::Solver(CSP _problem) : problem(_problem) {
+Solver::Solver(const CSP& _problem) : problem(_problem) {
     unsetVariables = problem.getVariables();
     setDefaultParameters();
     initAllDifferent();
+    initPropagators();
 }
 
 void Solver::setDefaultParameters() {
@@ -44,6 +52,7 @@ void Solver::setVarChooser(const std::string _variableChooser) {
     if (_variableChooser == "smallest") varChooser = std::make_unique<SmallestDomainVariableChooser>();
     else if (_variableChooser == "random") varChooser = std::make_unique<RandomVariableChooser>();
     else if (_variableChooser == "max") varChooser = std::make_unique<MaxConstraintVariableChooser>();
+    else if (_variableChooser == "dsatur") varChooser = std::make_unique<DSaturVariableChooser>();
     else throw std::logic_error("Wrong variable chooser");
     parameters[2] = _variableChooser;
 }
@@ -52,12 +61,15 @@ void Solver::setValChooser(const std::string _valueChooser) {
     if (_valueChooser == "copy") valueChooser = std::make_unique<CopyValueChooser>();
     else if (_valueChooser == "smallest") valueChooser = std::make_unique<SmallestValueChooser>();
     else if (_valueChooser == "random") valueChooser = std::make_unique<RandomValueChooser>();
+    else if (_valueChooser == "lcv") valueChooser = std::make_unique<LeastConstrainingValueChooser>(valueScores);
     else throw std::logic_error("Wrong value chooser");
+    scoreValues = (_valueChooser == "lcv");
     parameters[3] = _valueChooser;
 }
 
 void Solver::setValLambdaChooser(const std::function<bool(int,int)> lambda) {
     valueChooser = std::make_unique<LambdaValueChooser>(lambda);
+    scoreValues = false;
     parameters[3] = "lambda";
 }
 
@@ -73,6 +85,23 @@ void Solver::setRandomSeed(const unsigned int _randomSeed) {
     parameters[5] = std::to_string(_randomSeed);
 }
 
+void Solver::setDecomposition(const std::string _decomposition) {
+    if (_decomposition == "none") decomposition = Decomposition::None;
+    else if (_decomposition == "root") decomposition = Decomposition::Root;
+    else if (_decomposition == "nodes") decomposition = Decomposition::Nodes;
+    else throw std::logic_error("Wrong decomposition");
+}
+
+void Solver::setMinimizeColors(const bool _minimizeColors) {
+    if (_minimizeColors && problem.getProblemType() != Problem::Color) throw std::logic_error("Only graph coloring can be optimized");
+    minimizeColors = _minimizeColors;
+}
+
+void Solver::setBreakColorSymmetry(const bool _breakColorSymmetry) {
+    if (_breakColorSymmetry && problem.getProblemType() != Problem::Color) throw std::logic_error("Only graph coloring has interchangeable colors");
+    breakColorSymmetry = _breakColorSymmetry;
+}
+
 void Solver::setNbSolutions(const unsigned int _nbSolutions) {
     nbSolutions = _nbSolutions; 
     parameters[6] = (_nbSolutions == INT_MAX) ? "all" : std::to_string(_nbSolutions);
@@ -115,16 +144,33 @@ void Solver::initAllDifferent() {
     }
 }
 
-void Solver::checkFeasibility(CSP _problem) {
+void Solver::initPropagators() {
+    for (int var:problem.getVariables()) {
+        varToPropagatorIdx.emplace(var,std::vector<unsigned int>());
+    }
+    unsigned int idx = 0;
+    for (const auto& propagator : problem.getPropagators()) {
+        propagators.push_back(propagator->clone());
+        for (int var:propagator->getVariables()) {
+            varToPropagatorIdx.at(var).push_back(idx);
+        }
+        idx++;
+    }
+    isQueuedPropagator.assign(propagators.size(), false);
+    propagatorChanges.resize(propagators.size());
+}
+
+void Solver::checkFeasibility(const CSP& _problem) {
     for (const auto &sol : solutions) {
         assert(sol.size() == _problem.nbVar());
         assert(_problem.feasible(sol));
     }
 }
 
-void Solver::removeConstraintValuePair(int x, int y, int a, int b) {
-    if (state == State::Solve) deltaConstrValPair.back().push_back(std::make_tuple(x,y,a,b));
-    problem.removeConstraintValuePair(x, y, a, b);
+unsigned int Solver::decrementSupportCount(int x, int y, int a) {
+    int idx = problem.getConstraints().at(x).at(y)->getValueIndex(a);
+    if (state == State::Solve) deltaSupportCounts.back().push_back(std::make_tuple(x,y,idx));
+    return --supportCounts.at(std::make_pair(x,y)).at(std::size_t(idx));
 }
 
 void Solver::updateAddAllDiff(int var, int value) {
@@ -134,16 +180,16 @@ void Solver::updateAddAllDiff(int var, int value) {
 }
 
 bool Solver::updateRemoveAllDiff(int var, int value) {
-    std::vector<std::pair<int,int>> varsToFix;
+    std::pmr::vector<std::pair<int,int>> varsToFix(&arena);
     for (unsigned int familyIdx : varToAllDifferentFamilyIdx.at(var)) {
         if (!allDifferentFamilies[familyIdx].remove(var, value, varsToFix)) return false;
     }
     return fixVariables(varsToFix);
 }
 
-bool Solver::updateSetAllDiff(int var, int value, const std::vector<int>& values) {
+bool Solver::updateSetAllDiff(int var, int value, const std::unordered_set<int>& domain) {
     if (varToAllDifferentFamilyIdx.at(var).empty()) return true;
-    for (int valToRemove : values) {
+    for (int valToRemove : domain) {
         if (valToRemove != value) {
             if (!updateRemoveAllDiff(var, valToRemove)) return false;
         }
@@ -151,17 +197,57 @@ bool Solver::updateSetAllDiff(int var, int value, const std::vector<int>& values
     return true;
 }
 
-void Solver::backtrackAllDiff(int var, const std::vector<int>& values) {
+void Solver::backtrackAllDiff(int var, const std::unordered_set<int>& domain) {
     if (varToAllDifferentFamilyIdx.at(var).empty()) return;
-    for (int value : values) {
+    for (int value : domain) {
         updateAddAllDiff(var,value);
     }
 }
 
-bool Solver::fixVariables(const std::vector<std::pair<int,int>>& varsToFix) {
+void Solver::initValueScores() {
+    valueScores.clear();
+    for (int x : problem.getVariables()) {
+        std::unordered_map<int,long>& scores = valueScores[x];
+        for (int a : problem.getDomain(x)) scores[a] = 0;
+    }
+}
+
+void Solver::scoreDomain(int var, const std::unordered_set<int>& domain) {
+    std::unordered_map<int,long>& scores = valueScores.at(var);
+    for (int a : domain) scores.at(a) = 0;
+    for (const auto& [y,Cxy] : problem.getConstraints().at(var)) {
+        // A set neighbor adds the same to all the values left to var
+        if (!unsetVariables.count(y)) continue;
+        const std::unordered_set<int>& Dy = problem.getDomain(y);
+        if (Cxy->isExtensive && solveMethod == SolveMethod::AC4) {
+            const std::vector<unsigned int>& counts = supportCounts.at(std::make_pair(var,y));
+            for (int a : domain) {
+                // A value out of the relation has no support, the root removes it
+                int idx = Cxy->getValueIndex(a);
+                if (idx >= 0) scores.at(a) += long(counts[std::size_t(idx)]);
+            }
+            continue;
+        }
+        for (int a : domain) {
+            scoredValues.clear();
+            if (Cxy->isExtensive) {
+                Cxy->getSupport(a, scoredValues);
+                long& score = scores.at(a);
+                for (int b : scoredValues) score += long(Dy.count(b));
+            } else {
+                Cxy->getForbiddenValues(a, Dy, scoredValues);
+                scores.at(a) -= long(scoredValues.size());
+            }
+        }
+    }
+}
+
+bool Solver::fixVariables(const std::pmr::vector<std::pair<int,int>>& varsToFix) {
     for (auto [var,value] : varsToFix) {
         if (setVariables.count(var)) continue;
-        for (int valToRemove : problem.getDomainCopy(var)) {
+        // Fixing a variable can fix others, each nested call has its copy in the arena
+        std::pmr::vector<int> domain(problem.getDomain(var).begin(), problem.getDomain(var).end(), &arena);
+        for (int valToRemove : domain) {
             if (valToRemove != value) {
                 if (solveMethod == SolveMethod::AC4) addAC4List(var, valToRemove);
                 if (!removeVarValue(var, valToRemove)) return false;
@@ -179,8 +265,10 @@ bool Solver::fixVariables(const std::vector<std::pair<int,int>>& varsToFix) {
 
 bool Solver::removeVarValue(int var, int value) {
     if (problem.getDomain(var).count(value)==0) return true;
+    nbRemovals++;
     if (state == State::Solve) deltaDomains.back().push_back(std::make_pair(var,value));
     problem.removeVariableValue(var, value);
+    schedulePropagators(var);
     if (!updateRemoveAllDiff(var, value)) return false;
     switch (problem.getDomainSize(var)) 
     {
@@ -188,7 +276,7 @@ bool Solver::removeVarValue(int var, int value) {
     {
         int onlyValue = *problem.getDomain(var).begin();
         if (solveMethod == SolveMethod::LazyPropagate) 
-            lazyPropagateList.emplace(std::make_pair(var,onlyValue));
+            listNodes.insert(lazyPropagateList, std::make_pair(var,onlyValue));
         break;
     }
     case 0: 
@@ -208,7 +296,10 @@ bool Solver::forwardChecking(int x, int a) {
     assert(solveMethod == SolveMethod::LazyPropagate || solveMethod == SolveMethod::ForwardChecking);
     for (const auto& [y, Cxy] : problem.getConstraints().at(x)) {
         if (unsetVariables.count(y)) {
-            for (int b : Cxy->getForbiddenValues(a, problem.getDomain(y))) {
+            nbRevisions++;
+            forbiddenValues.clear();
+            Cxy->getForbiddenValues(a, problem.getDomain(y), forbiddenValues);
+            for (int b : forbiddenValues) {
                 if (!removeVarValue(y, b)) return false;
             }
         }
@@ -217,14 +308,17 @@ bool Solver::forwardChecking(int x, int a) {
 }
 
 void Solver::removeLazyPropagateList(int x, int a) {
-    lazyPropagateList.erase(std::make_pair(x,a));
+    listNodes.erase(lazyPropagateList, std::make_pair(x,a));
     setVar(x,a);
 }
 
 bool Solver::lazyPropagate(int var, int value) {
     assert(solveMethod == SolveMethod::LazyPropagate);
     if (!forwardChecking(var,value)) return false;
-    
+    return lazyPropagate();
+}
+
+bool Solver::lazyPropagate() {
     while (!lazyPropagateList.empty()) {
         auto [x,a] = *lazyPropagateList.begin();
         removeLazyPropagateList(x,a);
@@ -233,24 +327,94 @@ bool Solver::lazyPropagate(int var, int value) {
     return true;
 }
 
-void Solver::cleanConstraints(){
+bool Solver::hasResidualSupport(int x, int y, int a) {
+    const Constraint& Cxy = *problem.getConstraints().at(x).at(y);
+    const std::unordered_set<int>& Dy = problem.getDomain(y);
+    std::unordered_map<int,int>& residuesXY = residues[std::make_pair(x,y)];
+    auto residue = residuesXY.find(a);
+    if (residue != residuesXY.end() && Dy.count(residue->second)) return true;
+    for (int b : Dy) {
+        if (Cxy.feasible(a,b)) {
+            residuesXY[a] = b;
+            residueWatchers[std::make_pair(y,b)].push_back(std::make_pair(x,a));
+            return true;
+        }
+    }
+    return false;
+}
+
+void Solver::reviseResidues(int y, int b, std::vector<std::pair<int,int>>& unsupported) {
+    auto watchersIt = residueWatchers.find(std::make_pair(y,b));
+    if (watchersIt == residueWatchers.end()) return;
+    // The entry keeps the memory of the buffer for the watchers kept
+    revisedWatchers.clear();
+    revisedWatchers.swap(watchersIt->second);
+    for (auto [x,a] : revisedWatchers) {
+        if (residues.at(std::make_pair(x,y)).at(a) != b) continue; // stale watcher
+        nbRevisions++;
+        if (problem.getDomain(x).count(a) && !hasResidualSupport(x,y,a)) unsupported.push_back(std::make_pair(x,a));
+        // Keep watching b while it is still the residue, it may come back on backtrack
+        if (residues.at(std::make_pair(x,y)).at(a) == b) residueWatchers[std::make_pair(y,b)].push_back(std::make_pair(x,a));
+    }
+}
+
+bool Solver::hasSupport(int x, int y, int a) {
+    const Constraint& Cxy = *problem.getConstraints().at(x).at(y);
+    if (!Cxy.isExtensive) return hasResidualSupport(x, y, a);
+    supportValues.clear();
+    Cxy.getSupport(a, supportValues);
+    for (int b : supportValues) {
+        if (problem.getDomain(y).count(b)) return true;
+    }
+    return false;
+}
+
+void Solver::initSupportCounts() {
+    assert(state == State::Preprocess);
+    supportCounts.clear();
+    std::vector<int> support;
     for (const auto& [x,Cx] : problem.getConstraints()) {
         for (const auto& [y,Cxy] : Cx) {
-            for (auto [a,b] : Cxy->getUselessPairs(problem.getDomain(x))) {
-                removeConstraintValuePair(x,y,a,b);
+            if (!Cxy->isExtensive) continue;
+            // Values of the relation out of the domain keep a count of 0, AC4 never reads it
+            std::vector<unsigned int>& counts = supportCounts[std::make_pair(x,y)];
+            counts.assign(Cxy->nbValues(), 0);
+            for (int a : problem.getDomain(x)) {
+                int idx = Cxy->getValueIndex(a);
+                if (idx < 0) continue;
+                support.clear();
+                Cxy->getSupport(a, support);
+                unsigned int count = 0;
+                for (int b : support) count += (unsigned int)(problem.getDomain(y).count(b));
+                counts[std::size_t(idx)] = count;
             }
         }
     }
 }
 
+void Solver::extensifyConstraints() {
+    assert(state == State::Preprocess);
+    unsigned int nbExtensive = 0;
+    for (const auto& [x,Cx] : problem.getConstraints()) {
+        for (const auto& [y,Cxy] : Cx) {
+            if (x < y && problem.extensify(x,y)) nbExtensive++;
+        }
+    }
+    std::cout << "Extensified " << nbExtensive << "/" << problem.nbConstraints() << " constraints into ";
+    std::cout << problem.nbRelations() << " distinct relations (";
+    std::cout << problem.getExtensionSize() / (1 << 20) << " MB with the support counts), the others use residual supports" << std::endl;
+}
+
 bool Solver::initAC4Root() {
     assert(solveMethod == SolveMethod::AC4);
     assert(state == State::Preprocess);
-    cleanConstraints();
+    // Values already removed are accounted for by counting supports over the current domains
+    AC4List.clear();
+    initSupportCounts();
     for (const auto& [x,Cx] : problem.getConstraints()) {
         for (const auto& [y,Cxy] : Cx) {
             for (int a : problem.getDomain(x)) {
-                if (Cxy->getSupportSize(a)==0) {
+                if (!hasSupport(x, y, a)) {
                     addAC4List(x, a);
                 }
             }
@@ -263,30 +427,21 @@ bool Solver::initAC4Root() {
 }
 
 void Solver::removeAC3List(int x, int y) {
-    AC3List.erase(std::make_pair(x,y));
-    int onlyVal = *problem.getDomain(y).begin();
-    if (problem.getDomainSize(y) == 1) setVar(y,onlyVal);
+    listNodes.erase(AC3List, std::make_pair(x,y));
+    if (problem.getDomainSize(y) == 1) setVar(y, *problem.getDomain(y).begin());
 }
 
 bool Solver::AC3() {
     while (!AC3List.empty()) {
         auto [x,y] = *AC3List.begin();
         removeAC3List(x,y);
-        std::vector<int> domain;
-        domain.insert(domain.end(), problem.getDomain(x).begin(), problem.getDomain(x).end());
-        for (int v : domain) {
-            bool hasSupport = false;
-            for (int w : problem.getDomain(y)) {
-                if (problem.getConstraints().at(x).at(y)->feasible(v,w)) {
-                    hasSupport = true;
-                    break;
-                }
-            }
-            if (!hasSupport) {
-                if (!removeVarValue(x, v)) return false;
-                for (const auto& [z, Cxz] : problem.getConstraints().at(x)) {
-                    if (unsetVariables.count(z) && z != y) addAC3List(z, x);
-                }
+        nbRevisions++;
+        unsupportedValues.clear();
+        problem.getConstraints().at(x).at(y)->getUnsupported(problem.getDomain(x), problem.getDomain(y), unsupportedValues);
+        for (int v : unsupportedValues) {
+            if (!removeVarValue(x, v)) return false;
+            for (const auto& [z, Cxz] : problem.getConstraints().at(x)) {
+                if (unsetVariables.count(z) && z != y) addAC3List(z, x);
             }
         }
     }
@@ -306,14 +461,15 @@ bool Solver::initAC3Root() {
 
 bool Solver::initAC3Solve(int var) {
     assert(solveMethod == SolveMethod::AC3);
-    assert(state == State::Solve);
+    // A stop may come from another thread during the branch
+    assert(state != State::Preprocess);
     for (const auto& [y,Cxy] : problem.getConstraints().at(var)) {
         if (unsetVariables.count(y)) addAC3List(y, var);
     }
     return true;
 }
 
-bool Solver::initAC4Solve(int var, int value, std::vector<int> oldDomain) {
+bool Solver::initAC4Solve(int var, int value, const std::unordered_set<int>& oldDomain) {
     assert(state != State::Preprocess);
     for (int d : oldDomain) {
         if (d != value) addAC4List(var, d);
@@ -322,7 +478,7 @@ bool Solver::initAC4Solve(int var, int value, std::vector<int> oldDomain) {
 }
 
 void Solver::removeAC4List(int x, int a) {
-    AC4List.erase(std::make_pair(x,a));
+    listNodes.erase(AC4List, std::make_pair(x,a));
     int onlyVal = *problem.getDomain(x).begin();
     if (problem.getDomainSize(x) == 1) setVar(x,onlyVal);
 }
@@ -332,30 +488,41 @@ bool Solver::AC4() {
     while(!AC4List.empty()) {
         auto [y,b] = *AC4List.begin();
         removeAC4List(y,b);
-        std::vector<std::pair<int,int>> toPropagate;
+        toPropagate.clear();
         for (const auto& [x, Cyx]:problem.getConstraints().at(y)) {
-            if (Cyx->getSupportSize(b)==0) continue;
-            for (int a:Cyx->getSupport(b)) {
+            if (!Cyx->isExtensive || Cyx->getSupportSize(b)==0) continue;
+            supportValues.clear();
+            Cyx->getSupport(b, supportValues);
+            for (int a:supportValues) {
                 toPropagate.push_back(std::make_pair(x,a));
             }
         }
         for (auto [x,a] : toPropagate) {
-            removeConstraintValuePair(x,y,a,b);
-            if (problem.getConstraints().at(x).at(y)->getSupportSize(a) == 0 && problem.getDomain(x).count(a)) {
+            // Counts of removed values are not maintained, they are restored on backtrack
+            if (!problem.getDomain(x).count(a)) continue;
+            nbRevisions++;
+            if (decrementSupportCount(x,y,a) == 0) {
                 if (removeVarValue(x,a)) addAC4List(x,a);
                 else return false;
             }
         }
+        // Constraints without support lists: only values whose residue was b lost a support
+        unsupportedPairs.clear();
+        reviseResidues(y, b, unsupportedPairs);
+        for (auto [x,a] : unsupportedPairs) {
+            if (!problem.getDomain(x).count(a)) continue;
+            if (removeVarValue(x,a)) addAC4List(x,a);
+            else return false;
+        }
     }
     return true;
 }
 
 bool Solver::checkAC() {
-    cleanConstraints();
     for (const auto& [x,Cx] : problem.getConstraints()) {
         for (const auto& [y,Cxy] : Cx) {
             for (int a : problem.getDomain(x)) {
-                if (Cxy->getSupportSize(a)==0) {
+                if (!hasSupport(x, y, a)) {
                     return false;
                 }
             }
@@ -365,48 +532,56 @@ bool Solver::checkAC() {
 }
 
 void Solver::setVar(int var, int value) {
-    if (!unsetVariables.erase(var)) return;
+    if (!unsetVariableNodes.erase(unsetVariables, var)) return;
     if (state == State::Solve) deltaSetVars.back().push_back(var);
-    setVariables.emplace(var,value);
+    setVariableNodes.insert(setVariables, var, value);
     problem.fixValue(var,value);
+    if (breakColorSymmetry) colorUses[value]++;
 }
 
 void Solver::unsetVar(int var) {
-    setVariables.erase(var);
-    unsetVariables.emplace(var);
+    if (breakColorSymmetry) {
+        int value = setVariables.at(var);
+        if (--colorUses.at(value) == 0) colorUses.erase(value);
+    }
+    setVariableNodes.erase(setVariables, var);
+    unsetVariableNodes.insert(unsetVariables, var);
 }
 
 void Solver::backtrack() {
-    AC4List.clear();
-    AC3List.clear();
-    lazyPropagateList.clear();
+    listNodes.clear(AC4List);
+    listNodes.clear(AC3List);
+    listNodes.clear(lazyPropagateList);
+    clearPropagatorQueue();
     for (auto [y,b] : deltaDomains.back()) {
         addVarValue(y, b);
     }
     deltaDomains.pop_back();
 
-    for (auto[x, y, a, b] : deltaConstrValPair.back()) {
-        problem.addConstraintValuePair(x, y, a, b);
+    for (auto[x, y, idx] : deltaSupportCounts.back()) {
+        supportCounts.at(std::make_pair(x,y)).at(std::size_t(idx))++;
     }
-    deltaConstrValPair.pop_back();
+    deltaSupportCounts.pop_back();
 
     for (int y : deltaSetVars.back()) {
         unsetVar(y);
     }
     deltaSetVars.pop_back();
+    arena.release(arenaMarks.back());
+    arenaMarks.pop_back();
 }
 
 void Solver::preprocess() {
+    if (quiet) return;
     std::cout << "Launch presolve with rootSolveMethod=" << parameters[0] << ":" << std::endl;
-    if (solveMethod == SolveMethod::AC4) {
-        std::cout << "Extensify constraints for AC4..." << std::endl;
-        problem.extensify();
-        std::cout << "Done." << std::endl;
-    }
 }
 
 bool Solver::presolve() {
-    std::vector<std::pair<int,int>> varsToFix;
+    // The model may already leave a domain empty, which the propagations below do not expect
+    for (int var : problem.getVariables()) {
+        if (problem.getDomainSize(var) == 0) return false;
+    }
+    std::pmr::vector<std::pair<int,int>> varsToFix;
     for (const AllDifferentFamily& family : allDifferentFamilies) {
         if (!family.init(varsToFix)) return false;
     }
@@ -414,6 +589,11 @@ bool Solver::presolve() {
     if (solveMethod == SolveMethod::AC4) {
         bool consistent = initAC4Root() && AC4();
         if(!consistent) return false;
+        // Constraints are only extensified now, over the post-root domains
+        if (nodeSolveMethod == SolveMethod::AC4) {
+            extensifyConstraints();
+            initSupportCounts();
+        }
         assert(checkAC());
     }
     if (solveMethod == SolveMethod::AC3) {
@@ -449,125 +629,898 @@ bool Solver::presolve() {
             break;
         }
     }
-    if (unsetVariables.size() == 0) solutions.push_back(setVariables);
+    for (int var: problem.getVariables()) {
+        schedulePropagators(var);
+    }
+    if (!propagateFixpoint()) return false;
+    if (singletonConsistency && !singletonArcConsistency()) return false;
+    if (peelTrees) {
+        // Solutions differing only on the trees are not enumerated
+        if (nbSolutions != 1 || countOnly || minimizeColors) throw std::logic_error("Tree peeling only searches for one solution");
+        if (!peelForests()) return false;
+    }
+    if (unsetVariables.size() == 0) addSolution();
+    if (quiet) return true;
     std::cout << "Presolve fixed " << setVariables.size()<< "/" << problem.nbVar() << " variables"<<std::endl;
     std::cout << std::endl;
     return true;
 }
 
+bool Solver::singletonArcConsistency() {
+    const auto start = std::chrono::steady_clock::now();
+    auto expired = [this, &start]() {
+        return singletonTimeLimit >= 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= singletonTimeLimit;
+    };
+    // Probes use the root solve method on copies of the root state
+    std::vector<std::string> probeParameters = parameters;
+    probeParameters[1] = probeParameters[0];
+    std::vector<std::unique_ptr<Solver>> probers;
+    for (unsigned int t=0; t<nbThreads; t++) {
+        probers.push_back(std::make_unique<Solver>(problem, probeParameters, false));
+        probers.back()->setQuiet(true);
+        if (!probers.back()->initSolve()) return false;
+    }
+    unsigned int nbRounds = 0;
+    std::size_t nbRemoved = 0;
+    bool stopped = false;
+    while (!stopped) {
+        nbRounds++;
+        std::vector<std::pair<int,int>> candidates;
+        for (int var : unsetVariables) {
+            if (problem.getDomainSize(var) < 2) continue;
+            for (int value : problem.getDomain(var)) candidates.push_back(std::make_pair(var, value));
+        }
+        // Values inconsistent in the root state, found by each prober
+        std::vector<std::vector<std::pair<int,int>>> failed(probers.size());
+        std::atomic<std::size_t> next{0};
+        std::atomic<bool> timeout{false};
+        auto work = [&candidates, &failed, &next, &timeout, &expired](Solver& prober, std::size_t t) {
+            for (std::size_t idx=next++; idx<candidates.size(); idx=next++) {
+                if (timeout || expired()) {
+                    timeout = true;
+                    return;
+                }
+                auto [var,value] = candidates[idx];
+                if (!prober.probe(var, value)) failed[t].push_back(candidates[idx]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (std::size_t t=1; t<probers.size(); t++) threads.emplace_back(work, std::ref(*probers[t]), t);
+        work(*probers[0], 0);
+        for (auto& t : threads) t.join();
+        stopped = timeout;
+
+        std::vector<std::pair<int,int>> removals;
+        for (const auto& f : failed) removals.insert(removals.end(), f.begin(), f.end());
+        if (removals.empty()) break;
+        nbRemoved += removals.size();
+        for (auto [var,value] : removals) {
+            if (!removePropagatedValue(var, value)) return false;
+        }
+        if (!propagateRemovals() || !setSingletons() || !propagateFixpoint()) return false;
+        if (stopped) break;
+        for (auto& prober : probers) {
+            if (!prober->removeAtRoot(removals)) return false;
+        }
+    }
+    if (!quiet) {
+        std::cout << "Singleton arc consistency removed " << nbRemoved << " values in " << nbRounds << " rounds";
+        std::cout << (stopped ? " before its time limit" : "") << std::endl;
+    }
+    return true;
+}
+
+bool Solver::peelForests() {
+    // Global constraints are not binary, their variables stay in the search
+    auto peelable = [this](int var) {
+        return varToPropagatorIdx.at(var).empty() && varToAllDifferentFamilyIdx.at(var).empty();
+    };
+    std::unordered_map<int,unsigned int> degrees;
+    std::vector<int> leaves;
+    for (int var : unsetVariables) {
+        unsigned int degree = 0;
+        for (const auto& [y,Cxy] : problem.getConstraints().at(var)) {
+            if (unsetVariables.count(y)) degree++;
+        }
+        degrees.emplace(var, degree);
+        if (degree <= 1 && peelable(var)) leaves.push_back(var);
+    }
+    while (!leaves.empty()) {
+        int x = leaves.back();
+        leaves.pop_back();
+        if (!unsetVariables.erase(x)) continue;
+        int parent = x;
+        for (const auto& [y,Cxy] : problem.getConstraints().at(x)) {
+            if (!unsetVariables.count(y)) continue;
+            parent = y;
+            // Directional arc consistency: each value of the parent keeps a support in x
+            const std::unordered_set<int>& Dx = problem.getDomain(x);
+            for (int b : problem.getDomainCopy(y)) {
+                bool supported = std::any_of(Dx.begin(), Dx.end(), [&Cxy = *Cxy, b](int a) {return Cxy.feasible(a, b);});
+                if (!supported && !removePropagatedValue(y, b)) return false;
+            }
+            if (--degrees.at(y) <= 1 && peelable(y)) leaves.push_back(y);
+        }
+        peeledVariables.push_back(std::make_pair(x, parent));
+    }
+    if (!quiet) std::cout << "Peeled " << peeledVariables.size() << " variables of tree shaped parts" << std::endl;
+    return propagateRemovals() && setSingletons() && propagateFixpoint();
+}
+
+void Solver::completePeeled(std::unordered_map<int,int>& solution) const {
+    for (auto it=peeledVariables.rbegin(); it!=peeledVariables.rend(); it++) {
+        auto [x,parent] = *it;
+        const std::unordered_set<int>& Dx = problem.getDomain(x);
+        auto value = Dx.begin();
+        if (parent != x) {
+            const Constraint& Cxy = *problem.getConstraints().at(x).at(parent);
+            int parentValue = solution.at(parent);
+            value = std::find_if(Dx.begin(), Dx.end(), [&Cxy, parentValue](int a) {return Cxy.feasible(a, parentValue);});
+        }
+        assert(value != Dx.end());
+        solution[x] = *value;
+    }
+}
+
+bool Solver::setSingletons() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int var : std::vector<int>(unsetVariables.begin(), unsetVariables.end())) {
+            if (problem.getDomainSize(var) != 1) continue;
+            int value = *problem.getDomain(var).begin();
+            setVar(var, value);
+            changed = true;
+            if (solveMethod == SolveMethod::ForwardChecking && !forwardChecking(var, value)) return false;
+        }
+    }
+    return true;
+}
+
+void Solver::pushTrailLevel() {
+    arenaMarks.push_back(arena.mark());
+    deltaSetVars.emplace_back(&arena);
+    deltaDomains.emplace_back(&arena);
+    deltaSupportCounts.emplace_back(&arena);
+}
+
 void Solver::branchOnVar(int var, int value) {
     nbNodesExplored++;
-    deltaSetVars.push_back({});
-    deltaDomains.push_back({});
-    deltaConstrValPair.push_back({});
+    pushTrailLevel();
     setVar(var, value);
 }
 
-void Solver::unbranchOnVar(int var, std::vector<int> values) {
-    for (int value : values) {
-        addVarValue(var, value);
+bool Solver::branch(int var, int value, const std::unordered_set<int>& domain) {
+    branchOnVar(var, value);
+    bool consistent = updateSetAllDiff(var, value, domain);
+    if (consistent) {
+        if (solveMethod == SolveMethod::AC4) initAC4Solve(var, value, domain);
+        else if (solveMethod == SolveMethod::AC3) initAC3Solve(var);
+        consistent = checkConsistent(var, value);
     }
+    if (!consistent) {
+        backtrack();
+        backtrackAllDiff(var, domain);
+        return false;
+    }
+    if (solveMethod == SolveMethod::AC4) assert(checkAC());
+    return true;
+}
+
+void Solver::unbranchOnVar(int var, std::unordered_set<int>& domain) {
+    // The families already got the values back when the branches were undone
+    problem.swapDomain(var, domain);
 }
 
 void Solver::solve() {
     displayLogo();
     displayModelInformation();
-    if (nodeSolveMethod > rootSolveMethod) {
-        rootSolveMethod = nodeSolveMethod;
-        parameters[0] = parameters[1];
+    if (countOnly && problem.getProblemType() == Problem::Queens && problem.nbVar() <= QueensCounter::MAX_QUEENS) {
+        countQueens();
+        return;
     }
-    solveMethod = rootSolveMethod;
-
-    preprocess();
-
-    if (!presolve()) {
+    // Color minimization reads back its last solution
+    if (solutionSink && minimizeColors) throw std::logic_error("Color minimization keeps its solutions");
+    if (!initSolve()) {
+        if (solutionSink) solutionSink->end();
         std::cout << "inconsistent" << std::endl;
         return;
     }
-    if (hasFoundSolution()) {
+    if (!dumpPath.empty()) {
+        ModelFile::write(problem, dumpPath);
+        std::cout << "Model written to " << dumpPath << std::endl;
+    }
+    // The minimization of the colors still has to prove that a solution of the root is optimal
+    if (hasFoundSolution() && !minimizeColors) {
+        if (solutionSink) solutionSink->end();
         displayFinalInformation();
         return;
     }
-    solveMethod = nodeSolveMethod;
-    state = State::Solve;
     displaySolveInformation();
+    if (treeDecompositionSearch) {
+        // Goods only keep the first solution of a subtree
+        if (nbSolutions != 1 && !countOnly) throw std::logic_error("Tree decomposition search counts solutions or looks for one");
+        if (minimizeColors || decomposition != Decomposition::None) throw std::logic_error("Tree decomposition search already splits the problem");
+    }
+    if (decomposition != Decomposition::None && !minimizeColors && !initComponentSolvers()) {
+        if (solutionSink) solutionSink->end();
+        std::cout << "inconsistent" << std::endl;
+        return;
+    }
     start_time = clock();
     std::vector<std::thread> threads;
     if (timeLimit < INT_MAX) threads.emplace_back(std::thread(&Solver::timeThread, this));
-    threads.emplace_back(std::thread(&Solver::launchSolve, this));
+    if (componentSolvers.empty()) threads.emplace_back(std::thread(&Solver::launchSolve, this));
+    else threads.emplace_back(std::thread(&Solver::launchComponents, this));
     if (verbosity) threads.emplace_back(std::thread(&Solver::solveVerbosity, this));
     for (auto& t : threads) t.join();
+    if (solutionSink) solutionSink->end();
 
     displayFinalInformation();
 }
 
+bool Solver::initSolve() {
+    if (nodeSolveMethod > rootSolveMethod) {
+        rootSolveMethod = nodeSolveMethod;
+        parameters[0] = parameters[1];
+    }
+    solveMethod = rootSolveMethod;
+
+    preprocess();
+
+    if (!presolve()) return false;
+    solveMethod = nodeSolveMethod;
+    state = State::Solve;
+    if (scoreValues) initValueScores();
+    return true;
+}
+
+bool Solver::solveWithRemovals(const std::vector<std::pair<int,int>>& removals) {
+    assert(state == State::Solve);
+    solutions.clear();
+    nbSolutionsFound = 0;
+    // Removals are trailed at their own level, below the branches of the search
+    pushTrailLevel();
+    bool consistent = true;
+    for (auto [var,value] : removals) {
+        if (!removePropagatedValue(var, value)) {
+            consistent = false;
+            break;
+        }
+    }
+    if (consistent && propagateRemovals()) search();
+    closeOpenBranches();
+    backtrack();
+    return hasFoundSolution();
+}
+
+bool Solver::removeAtRoot(const std::vector<std::pair<int,int>>& removals) {
+    assert(state == State::Solve);
+    pushTrailLevel();
+    for (auto [var,value] : removals) {
+        if (!removePropagatedValue(var, value)) return false;
+    }
+    return propagateRemovals();
+}
+
+bool Solver::probe(int var, int value) {
+    assert(state == State::Solve);
+    pushTrailLevel();
+    bool consistent = problem.getDomain(var).count(value);
+    for (int other : problem.getDomainCopy(var)) {
+        if (consistent && other != value) consistent = removePropagatedValue(var, other);
+    }
+    consistent = consistent && propagateRemovals();
+    backtrack();
+    return consistent;
+}
+
+void Solver::closeOpenBranches() {
+    for (auto& [var,domain] : openBranches) {
+        backtrack();
+        backtrackAllDiff(var, domain);
+        unbranchOnVar(var, domain);
+    }
+    openBranches.clear();
+}
+
+void Solver::minimizeNbColors() {
+    while (true) {
+        nbSolutions = nbSolutionsFound + 1;
+        if (!search()) break;
+        closeOpenBranches();
+        std::unordered_set<int> colors;
+        for (auto [var,value] : solutions.back()) colors.insert(value);
+        int nbColors = int(colors.size());
+        std::cout << "Coloring with " << nbColors << " colors" << std::endl;
+        if (nbColors <= int(problem.getColorLowerBound())) break;
+        // At the root the colors beyond the clique ones are interchangeable, the first ones are kept
+        std::vector<std::pair<int,int>> removals;
+        for (int var : problem.getVariables()) {
+            for (int value : problem.getDomain(var)) {
+                if (value >= nbColors - 1) removals.push_back(std::make_pair(var, value));
+            }
+        }
+        if (!removeAtRoot(removals)) break;
+    }
+    if (state == State::Stop) std::cout << "Best coloring found";
+    else std::cout << "Chromatic number";
+    if (hasFoundSolution()) {
+        std::unordered_set<int> colors;
+        for (auto [var,value] : solutions.back()) colors.insert(value);
+        std::cout << ": " << colors.size() << std::endl;
+    } else std::cout << ": none" << std::endl;
+}
+
+void Solver::countQueens() {
+    std::cout << "Launch bitboard queens counting; nbSolutions=" << parameters[6] << ":" << std::endl;
+    QueensCounter counter(int(problem.nbVar()));
+    const unsigned long long limit = (nbSolutions == INT_MAX) ? UINT64_MAX : nbSolutions;
+    const auto start = std::chrono::steady_clock::now();
+    nbSolutionsFound = counter.count(limit, std::max(std::thread::hardware_concurrency(), 1u), timeLimit);
+    // Wall clock time, the threads of the counter share the work
+    solve_time = clock_t(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * CLOCKS_PER_SEC);
+    nbNodesExplored = counter.getNbNodes();
+    state = State::Stop;
+    displayFinalInformation();
+}
+
+void Solver::addSolution() {
+    // A count of products of components may already be saturated
+    if (nbSolutionsFound < ULLONG_MAX) nbSolutionsFound++;
+    if (countOnly) return;
+    storeSolution(setVariables);
+}
+
+void Solver::storeSolution(const std::unordered_map<int,int>& solution) {
+    if (!solutionSink) {
+        solutions.push_back(solution);
+        completePeeled(solutions.back());
+        return;
+    }
+    if (solutionSink->needsValues()) {
+        const std::unordered_map<int,int>* completeSolution = &solution;
+        std::unordered_map<int,int> completed;
+        if (!peeledVariables.empty()) {
+            completed = solution;
+            completePeeled(completed);
+            completeSolution = &completed;
+        }
+        for (std::size_t i=0; i<sinkVariables.size(); i++) sinkValues[i] = completeSolution->at(sinkVariables[i]);
+    }
+    solutionSink->add(sinkValues);
+}
+
+void Solver::setSolutionSink(std::unique_ptr<SolutionSink> sink) {
+    solutionSink = std::move(sink);
+    if (!solutionSink) return;
+    sinkVariables.assign(problem.getVariables().begin(), problem.getVariables().end());
+    std::sort(sinkVariables.begin(), sinkVariables.end());
+    sinkValues.assign(sinkVariables.size(), 0);
+    solutionSink->begin(sinkVariables);
+}
+
 void Solver::timeThread() {
     while(state == State::Solve) {
         int time = (int)(clock() - start_time)/CLOCKS_PER_SEC;
-        if (time >= timeLimit) state = State::Stop;
+        if (time >= timeLimit) stop();
+        // clock() counts this thread too, a busy wait would spend half of the limit
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void Solver::stop() {
+    state = State::Stop;
+    for (auto& solver : componentSolvers) solver->stop();
+}
+
+std::vector<std::vector<int>> Solver::findComponents() const {
+    std::vector<std::vector<int>> components;
+    std::unordered_set<int> visited;
+    std::vector<bool> visitedPropagators(propagators.size(), false);
+    std::vector<bool> visitedFamilies(allDifferentFamilies.size(), false);
+    for (int start : unsetVariables) {
+        if (!visited.insert(start).second) continue;
+        std::vector<int> component = {start};
+        auto visit = [this, &visited, &component](int y) {
+            if (unsetVariables.count(y) && visited.insert(y).second) component.push_back(y);
+        };
+        for (std::size_t i=0; i<component.size(); i++) {
+            int var = component[i];
+            for (const auto& [y,Cxy] : problem.getConstraints().at(var)) visit(y);
+            for (unsigned int idx : varToPropagatorIdx.at(var)) {
+                if (visitedPropagators[idx]) continue;
+                visitedPropagators[idx] = true;
+                for (int y : propagators[idx]->getVariables()) visit(y);
+            }
+            for (unsigned int idx : varToAllDifferentFamilyIdx.at(var)) {
+                if (visitedFamilies[idx]) continue;
+                visitedFamilies[idx] = true;
+                for (int y : problem.getAllDifferentFamilies()[idx]) visit(y);
+            }
+        }
+        components.push_back(std::move(component));
+    }
+    return components;
+}
+
+bool Solver::initComponentSolvers() {
+    std::vector<std::vector<int>> components = findComponents();
+    if (components.size() < 2) return true;
+    // The largest components first, they are the longest to solve
+    std::sort(components.begin(), components.end(), [](const auto& a, const auto& b) {return a.size() > b.size();});
+    std::cout << "Solve " << components.size() << " independent components" << std::endl;
+    for (const std::vector<int>& component : components) {
+        auto solver = std::make_unique<Solver>(problem, parameters, false);
+        solver->setQuiet(true);
+        solver->setCountOnly(countOnly);
+        solver->breakColorSymmetry = breakColorSymmetry;
+        solver->decomposition = decomposition;
+        if (!solver->initSolve()) {
+            componentSolvers.clear();
+            return false;
+        }
+        const std::unordered_set<int> variables(component.begin(), component.end());
+        for (int var : std::vector<int>(solver->unsetVariables.begin(), solver->unsetVariables.end())) {
+            if (!variables.count(var)) solver->unsetVariables.erase(var);
+        }
+        componentSolvers.push_back(std::move(solver));
+    }
+    return true;
+}
+
+void Solver::launchComponents() {
+    srand(randomSeed);
+    std::atomic<std::size_t> next{0};
+    auto work = [this, &next]() {
+        for (std::size_t idx=next++; idx<componentSolvers.size() && state != State::Stop; idx=next++) {
+            Solver& solver = *componentSolvers[idx];
+            solver.search();
+            // A component without solution makes the others useless
+            if (!solver.hasFoundSolution()) stop();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int t=1; t<std::min(nbThreads, (unsigned int)(componentSolvers.size())); t++) threads.emplace_back(work);
+    work();
+    for (auto& t : threads) t.join();
+
+    // Solutions are the products of the solutions of the components
+    unsigned long long nbProducts = 1;
+    for (const auto& solver : componentSolvers) {
+        nbNodesExplored += solver->getNbNodesExplored();
+        unsigned long long nbComponentSolutions = solver->getNbSolutionsFound();
+        if (nbComponentSolutions == 0) nbProducts = 0;
+        else if (nbProducts > ULLONG_MAX / nbComponentSolutions) nbProducts = ULLONG_MAX;
+        else nbProducts *= nbComponentSolutions;
+    }
+    if (nbSolutions != INT_MAX) nbProducts = std::min(nbProducts, (unsigned long long)(nbSolutions));
+    // The products of solutions of stopped components are unbounded, the first one is kept
+    const bool stoppedSearch = (state == State::Stop);
+    if (stoppedSearch && !countOnly) nbProducts = std::min(nbProducts, 1ULL);
+    nbSolutionsFound = nbProducts;
+    if (!countOnly) {
+        // A stop during the enumeration ends it
+        std::vector<std::size_t> indices(componentSolvers.size(), 0);
+        for (unsigned long long k=0; k<nbProducts; k++) {
+            if (!stoppedSearch && state == State::Stop) {
+                nbSolutionsFound = k;
+                break;
+            }
+            std::unordered_map<int,int> solution = setVariables;
+            for (std::size_t c=0; c<componentSolvers.size(); c++) {
+                const auto& componentSolution = componentSolvers[c]->getSolutions()[indices[c]];
+                solution.insert(componentSolution.begin(), componentSolution.end());
+            }
+            storeSolution(solution);
+            // Next product, the last component changing fastest
+            for (std::size_t c=componentSolvers.size(); c-->0;) {
+                if (++indices[c] < componentSolvers[c]->getSolutions().size()) break;
+                indices[c] = 0;
+            }
+        }
+    }
+    solve_time = clock() - start_time;
+    state = State::Stop;
+}
+
+bool Solver::splitCount(std::vector<std::vector<int>>& components) {
+    const unsigned long long nbFound = nbSolutionsFound;
+    unsigned long long nbLeft = ULLONG_MAX;
+    if (nbSolutions != INT_MAX) nbLeft = (nbFound >= nbSolutions) ? 0 : nbSolutions - nbFound;
+    const unsigned int savedNbSolutions = nbSolutions;
+    std::unordered_set<int> variables;
+    variables.swap(unsetVariables);
+    unsigned long long nbProducts = 1;
+    for (const std::vector<int>& component : components) {
+        unsetVariables.insert(component.begin(), component.end());
+        // No more than nbLeft solutions of each component are needed
+        if (nbLeft < ULLONG_MAX) nbSolutions = (unsigned int)(nbSolutionsFound + nbLeft);
+        if (search()) closeOpenBranches();
+        unsigned long long nbComponentSolutions = nbSolutionsFound - nbFound;
+        nbSolutionsFound = nbFound;
+        unsetVariables.clear();
+        if (state == State::Stop || nbComponentSolutions == 0) {
+            nbProducts = 0;
+            break;
+        }
+        if (nbProducts > ULLONG_MAX / nbComponentSolutions) nbProducts = ULLONG_MAX;
+        else nbProducts *= nbComponentSolutions;
+    }
+    nbSolutions = savedNbSolutions;
+    unsetVariables.swap(variables);
+    // Saturated at nbLeft, then at ULLONG_MAX like the other counts
+    const unsigned long long nbNew = std::min(nbProducts, nbLeft);
+    nbSolutionsFound = (nbFound > ULLONG_MAX - nbNew) ? ULLONG_MAX : nbFound + nbNew;
+    return nbSolutionsFound == nbSolutions;
+}
+
+void Solver::treeDecompositionSolve() {
+    // Constraint graph of the unset variables, global constraints link all their variables
+    std::unordered_map<int,std::unordered_set<int>> graph;
+    for (int var : unsetVariables) graph[var];
+    auto link = [&graph](int x, int y) {
+        if (x == y || !graph.count(x) || !graph.count(y)) return;
+        graph.at(x).insert(y);
+        graph.at(y).insert(x);
+    };
+    for (int x : unsetVariables) {
+        for (const auto& [y,Cxy] : problem.getConstraints().at(x)) link(x, y);
+    }
+    std::vector<std::vector<int>> scopes;
+    for (const auto& propagator : propagators) scopes.push_back(propagator->getVariables());
+    if (!allDifferentFamilies.empty()) scopes.insert(scopes.end(), problem.getAllDifferentFamilies().begin(), problem.getAllDifferentFamilies().end());
+    for (const std::vector<int>& scope : scopes) {
+        for (int x : scope) {
+            for (int y : scope) link(x, y);
+        }
+    }
+    TreeDecomposition decomposition(std::move(graph));
+    clusters = decomposition.getClusters();
+    goods.assign(clusters.size(), {});
+    goodsMemory = 0;
+    countLimit = (nbSolutions == INT_MAX) ? ULLONG_MAX : nbSolutions;
+    std::cout << "Tree decomposition in " << clusters.size() << " clusters of width " << decomposition.getWidth() << std::endl;
+
+    unsigned long long nbFound = 1;
+    std::vector<std::pair<int,int>> solution;
+    for (std::size_t root : decomposition.getRoots()) {
+        std::vector<std::pair<int,int>> rootSolution;
+        unsigned long long nbRootSolutions = clusterSolve(root, countOnly ? nullptr : &rootSolution);
+        if (state == State::Stop || nbRootSolutions == 0) {
+            nbFound = 0;
+            break;
+        }
+        nbFound = (nbFound > ULLONG_MAX / nbRootSolutions) ? ULLONG_MAX : nbFound * nbRootSolutions;
+        solution.insert(solution.end(), rootSolution.begin(), rootSolution.end());
+    }
+    nbSolutionsFound = std::min(nbFound, countLimit);
+    if (!countOnly && hasFoundSolution()) {
+        std::unordered_map<int,int> fullSolution = setVariables;
+        fullSolution.insert(solution.begin(), solution.end());
+        storeSolution(fullSolution);
+    }
+    std::size_t nbGoods = 0;
+    std::size_t nbNogoods = 0;
+    for (const auto& clusterGoods : goods) {
+        for (const auto& [key,good] : clusterGoods) (good.count ? nbGoods : nbNogoods)++;
+    }
+    std::cout << nbGoods << " goods and " << nbNogoods << " nogoods recorded" << std::endl;
+}
+
+unsigned long long Solver::clusterSolve(std::size_t idx, std::vector<std::pair<int,int>>* solution) {
+    if (state == State::Stop) return 0;
+    std::unordered_set<int> candidates;
+    for (int var : clusters[idx].proper) {
+        if (unsetVariables.count(var)) candidates.insert(var);
+    }
+    if (candidates.empty()) return clusterChildrenSolve(idx, solution);
+    int currentDepth = (int) setVariables.size() + 1;
+    if (currentDepth > bestDepth) bestDepth = currentDepth;
+    int var = varChooser->choose(problem, candidates);
+    std::unordered_set<int> domain;
+    problem.swapDomain(var, domain);
+    if (scoreValues) scoreDomain(var, domain);
+    ValueCursor cursor;
+    valueChooser->start(var, domain, cursor);
+
+    unsigned long long count = 0;
+    int value;
+    while (valueChooser->next(cursor, value)) {
+        if (!branch(var, value, domain)) continue;
+        unsigned long long nbSubSolutions = clusterSolve(idx, count == 0 ? solution : nullptr);
+        if (state == State::Stop) return 0;
+        backtrack();
+        backtrackAllDiff(var, domain);
+        count = (count > ULLONG_MAX - nbSubSolutions) ? ULLONG_MAX : count + nbSubSolutions;
+        if (count >= countLimit) break;
+    }
+    unbranchOnVar(var, domain);
+    return std::min(count, countLimit);
+}
+
+unsigned long long Solver::clusterChildrenSolve(std::size_t idx, std::vector<std::pair<int,int>>* solution) {
+    unsigned long long count = 1;
+    std::vector<std::pair<int,int>> subtreeSolution;
+    for (std::size_t child : clusters[idx].children) {
+        // The subtree only depends on the values of the separator
+        std::vector<int> key;
+        key.reserve(clusters[child].separator.size());
+        for (int var : clusters[child].separator) key.push_back(setVariables.at(var));
+        auto found = goods[child].find(key);
+        Good good;
+        if (found != goods[child].end()) good = found->second;
+        else {
+            good.count = clusterSolve(child, solution ? &good.solution : nullptr);
+            if (state == State::Stop) return 0;
+            std::size_t size = sizeof(Good) + key.size() * sizeof(int) + good.solution.size() * sizeof(std::pair<int,int>);
+            if (goodsMemory + size <= goodsBudget) {
+                goodsMemory += size;
+                goods[child].emplace(std::move(key), good);
+            }
+        }
+        if (good.count == 0) return 0;
+        count = (count > ULLONG_MAX / good.count) ? ULLONG_MAX : count * good.count;
+        if (solution) subtreeSolution.insert(subtreeSolution.end(), good.solution.begin(), good.solution.end());
     }
+    if (solution) {
+        for (int var : clusters[idx].proper) subtreeSolution.push_back(std::make_pair(var, setVariables.at(var)));
+        *solution = std::move(subtreeSolution);
+    }
+    return std::min(count, countLimit);
+}
+
+bool Solver::splitSolve(std::vector<std::vector<int>>& components) {
+    // The smallest components first, a component without solution is found sooner
+    std::sort(components.begin(), components.end(), [](const auto& a, const auto& b) {return a.size() < b.size();});
+    unsigned int id = ++nbSplitNodes;
+    for (std::size_t i=components.size()-1; i>0; i--) {
+        pendingComponents.push_back(std::make_pair(std::move(components[i]), id));
+    }
+    std::unordered_set<int> variables(components[0].begin(), components[0].end());
+    variables.swap(unsetVariables);
+    bool found = search();
+    // The pending components of this node are back on top of the stack
+    while (!pendingComponents.empty() && pendingComponents.back().second == id) pendingComponents.pop_back();
+    nbSplitNodes--;
+    if (unwindTo == id) unwindTo = 0;
+    if (!found) unsetVariables.swap(variables);
+    return found;
+}
+
+bool Solver::solvePendingComponent() {
+    auto [variables, id] = std::move(pendingComponents.back());
+    pendingComponents.pop_back();
+    unsetVariables.insert(variables.begin(), variables.end());
+    unsigned long long nbFound = nbSolutionsFound;
+    bool found = search();
+    if (!found) {
+        unsetVariables.clear();
+        // The component does not depend on the search below its split node
+        if (nbSolutionsFound == nbFound && state != State::Stop) unwindTo = id;
+    }
+    pendingComponents.push_back(std::make_pair(std::move(variables), id));
+    return found;
 }
 
 void Solver::launchSolve() {
     srand(randomSeed);
-    recursiveSolve();
+    if (minimizeColors) minimizeNbColors();
+    else if (treeDecompositionSearch) treeDecompositionSolve();
+    else search();
     solve_time = clock() - start_time;
     state = State::Stop;
 }
 
 bool Solver::checkConsistent(int var, int value) {
+    bool consistent = false;
     switch (solveMethod) 
     {
     case SolveMethod::AC4: 
-       return AC4();
+        consistent = AC4();
+        break;
     case SolveMethod::AC3:
-        return AC3();
+        consistent = AC3();
+        break;
     case SolveMethod::ForwardChecking: 
-        return forwardChecking(var, value);
+        consistent = forwardChecking(var, value);
+        break;
     case SolveMethod::LazyPropagate: 
-        return lazyPropagate(var, value);
+        consistent = lazyPropagate(var, value);
+        break;
     default:
         break;
     }
-    return false;
+    if (!consistent) return false;
+    // Branching on var removed its other values
+    schedulePropagators(var);
+    return propagateFixpoint();
+}
 
+void Solver::schedulePropagator(unsigned int idx) {
+    if (isQueuedPropagator[idx]) return;
+    isQueuedPropagator[idx] = true;
+    propagatorQueue.push_back(idx);
 }
 
-bool Solver::recursiveSolve() {
-    if (state == State::Stop) return false;
-    if (unsetVariables.empty()) {
-        solutions.push_back(setVariables);
-        if (solutions.size() == nbSolutions) return true;
-        return false;
+void Solver::schedulePropagators(int var) {
+    for (unsigned int idx : varToPropagatorIdx.at(var)) {
+        propagatorChanges[idx].push_back(var);
+        schedulePropagator(idx);
     }
-    int currentDepth = (int) setVariables.size() + 1;
-    if (currentDepth > bestDepth) bestDepth = currentDepth;
-    int var = chooseVar();
-    std::vector<int> values = chooseValue(var);
-
-    for (int value : values) {
-        branchOnVar(var, value);
-        if (!updateSetAllDiff(var, value, values)) {
-            backtrack();
-            backtrackAllDiff(var, values);
-            continue;
+}
+
+void Solver::clearPropagatorQueue() {
+    if (propagatorQueue.empty()) return;
+    for (unsigned int idx : propagatorQueue) {
+        propagatorChanges[idx].clear();
+    }
+    propagatorQueue.clear();
+    std::fill(isQueuedPropagator.begin(), isQueuedPropagator.end(), false);
+}
+
+bool Solver::removePropagatedValue(int var, int value) {
+    if (problem.getDomain(var).count(value)==0) return true;
+    if (!removeVarValue(var, value)) return false;
+    if (solveMethod == SolveMethod::AC4) addAC4List(var, value);
+    if (solveMethod == SolveMethod::AC3) {
+        for (const auto& [y,Cxy] : problem.getConstraints().at(var)) {
+            if (unsetVariables.count(y)) addAC3List(y, var);
         }
-        if (solveMethod == SolveMethod::AC4) initAC4Solve(var, value, values);
-        else if (solveMethod == SolveMethod::AC3) initAC3Solve(var);
-        if (!checkConsistent(var, value)) {
-            backtrack();
-            backtrackAllDiff(var, values);
-            continue;
+    }
+    return true;
+}
+
+bool Solver::runPropagators() {
+    std::vector<std::pair<int,int>>& toRemove = propagatorRemovals;
+    std::vector<int>& changed = propagatorChanged;
+    while (!propagatorQueue.empty()) {
+        unsigned int idx = propagatorQueue.back();
+        propagatorQueue.pop_back();
+        nbRevisions++;
+        toRemove.clear();
+        changed.swap(propagatorChanges[idx]);
+        propagatorChanges[idx].clear();
+        bool consistent = propagators[idx]->propagate(problem.getDomains(), changed, toRemove);
+        std::vector<int>& changes = propagatorChanges[idx];
+        for (auto [var,value] : toRemove) {
+            if (!consistent) break;
+            std::size_t nbChanges = changes.size();
+            consistent = removePropagatedValue(var, value);
+            // Its own removal is already taken into account, unlike those it causes through other filters
+            if (changes.size() > nbChanges && changes[nbChanges] == var) changes.erase(changes.begin() + long(nbChanges));
+        }
+        isQueuedPropagator[idx] = false;
+        if (!consistent) {
+            changes.clear();
+            return false;
+        }
+        if (!changes.empty()) schedulePropagator(idx);
+    }
+    return true;
+}
+
+bool Solver::propagateRemovals() {
+    bool consistent = true;
+    switch (solveMethod) 
+    {
+    case SolveMethod::AC4: 
+        consistent = AC4();
+        break;
+    case SolveMethod::AC3:
+        consistent = AC3();
+        break;
+    case SolveMethod::LazyPropagate: 
+        consistent = lazyPropagate();
+        break;
+    default:
+        break;
+    }
+    return consistent && propagateFixpoint();
+}
+
+bool Solver::propagateFixpoint() {
+    while (!propagatorQueue.empty()) {
+        if (!runPropagators()) return false;
+        switch (solveMethod) 
+        {
+        case SolveMethod::AC4: 
+            if (!AC4()) return false;
+            break;
+        case SolveMethod::AC3:
+            if (!AC3()) return false;
+            break;
+        case SolveMethod::LazyPropagate: 
+            if (!lazyPropagate()) return false;
+            break;
+        default:
+            break;
         }
-        if (solveMethod == SolveMethod::AC4) assert(checkAC());
-        
-        if (recursiveSolve()) return true;
-        if (state == State::Stop) return false;
-        backtrack();
-        backtrackAllDiff(var, values);
     }
-    unbranchOnVar(var, values);
+    return true;
+}
+
+bool Solver::search() {
+    // Decisions below base belong to the search of an enclosing split node
+    const std::size_t base = decisionDepth;
+    while (true) {
+        // A new node is a leaf, a split node or a decision
+        bool found = false;
+        bool isDecision = false;
+        if (state == State::Stop) found = false;
+        else if (unsetVariables.empty()) {
+            if (!pendingComponents.empty()) found = solvePendingComponent();
+            else {
+                addSolution();
+                found = (nbSolutionsFound == nbSolutions);
+            }
+        } else {
+            int currentDepth = (int) setVariables.size() + 1;
+            if (currentDepth > bestDepth) bestDepth = currentDepth;
+            std::vector<std::vector<int>> components;
+            if (decomposition == Decomposition::Nodes) components = findComponents();
+            if (components.size() > 1) found = countOnly ? splitCount(components) : splitSolve(components);
+            else {
+                openDecision(chooseVar());
+                isDecision = true;
+            }
+        }
 
+        // Return the result to the decisions above until one of them has a next branch
+        bool returned = !isDecision;
+        while (true) {
+            if (returned) {
+                if (decisionDepth == base) return found;
+                Decision& decision = decisions[decisionDepth-1];
+                if (found) {
+                    for (std::size_t i=decisionDepth; i-->base;) openBranches.push_back(std::make_pair(decisions[i].var, std::move(decisions[i].domain)));
+                    decisionDepth = base;
+                    return true;
+                }
+                if (state == State::Stop) {
+                    decisionDepth = base;
+                    return false;
+                }
+                backtrack();
+                backtrackAllDiff(decision.var, decision.domain);
+                assert(deltaSetVars.size() == decision.trailLevel);
+                if (unwindTo) decision.exhausted = true;
+            }
+            Decision& decision = decisions[decisionDepth-1];
+            if (nextBranch(decision)) break;
+            unbranchOnVar(decision.var, decision.domain);
+            decisionDepth--;
+            found = false;
+            returned = true;
+        }
+    }
+}
+
+void Solver::openDecision(int var) {
+    if (decisionDepth == decisions.size()) decisions.emplace_back();
+    Decision& decision = decisions[decisionDepth++];
+    decision.var = var;
+    // The domain is given back by unbranchOnVar. The first branch replaces what is left
+    // of the last one, reusing its node.
+    problem.swapDomain(var, decision.domain);
+    if (scoreValues) scoreDomain(var, decision.domain);
+    valueChooser->start(var, decision.domain, decision.values);
+    decision.exhausted = false;
+    decision.trailLevel = deltaSetVars.size();
+    decision.triedFreshColor = false;
+}
+
+bool Solver::nextBranch(Decision& decision) {
+    int value;
+    // A stopped search opens no other branch
+    while (!decision.exhausted && state != State::Stop && valueChooser->next(decision.values, value)) {
+        // Colors of no vertex are interchangeable, a single one of them is tried
+        if (breakColorSymmetry && !colorUses.count(value)) {
+            if (decision.triedFreshColor) continue;
+            decision.triedFreshColor = true;
+        }
+        if (branch(decision.var, value, decision.domain)) return true;
+    }
     return false;
 }
 
@@ -575,12 +1528,12 @@ void Solver::solveVerbosity() {
     std::cout << " Time | n solutions | Best depth | Nodes explored"  << std::endl;
     std::cout << "-------------------------------------------------" << std::endl;
     while (state == State::Solve) {
-        int time = std::max((int)(clock() - start_time)/CLOCKS_PER_SEC,0);
-        std::cout << time << "       "  << solutions.size() << "            " << bestDepth << "            " << nbNodesExplored << std::endl;
+        int time = std::max((int)((clock() - start_time)/CLOCKS_PER_SEC),0);
+        std::cout << time << "       "  << nbSolutionsFound << "            " << bestDepth << "            " << nbNodesExplored << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(2000));
     }
-    int actualTime = std::min(std::max((int)(solve_time)/CLOCKS_PER_SEC,0), timeLimit);
-    std::cout << actualTime << "       "  << solutions.size() << "            " << bestDepth << "            " << nbNodesExplored << std::endl;
+    int actualTime = std::min(std::max((int)(solve_time/CLOCKS_PER_SEC),0), timeLimit);
+    std::cout << actualTime << "       "  << nbSolutionsFound << "            " << bestDepth << "            " << nbNodesExplored << std::endl;
     std::cout << "-------------------------------------------------" << std::endl;
 }
 
@@ -588,7 +1541,9 @@ void Solver::displayModelInformation() const{
     std::cout << std::endl;
     std::cout << "Initial problem: ";
     std::cout << problem.nbVar() << " variables / ";
-    std::cout << problem.nbConstraints() << " constraints" << std::endl;
+    std::cout << problem.nbConstraints() << " constraints";
+    if (!propagators.empty()) std::cout << " / " << propagators.size() << " propagators";
+    std::cout << std::endl;
     std::cout << std::endl;
 }
 
@@ -605,7 +1560,7 @@ void Solver::displaySolveInformation() const{
 }
 
 void Solver::displayFinalInformation() const{
-    if (hasFoundSolution()) std::cout << std::to_string(nbNodesExplored) + " nodes explored - Found " << solutions.size() << " solution(s)" << std::endl;
+    if (hasFoundSolution()) std::cout << std::to_string(nbNodesExplored) + " nodes explored - Found " << nbSolutionsFound << " solution(s)" << std::endl;
     else if (solve_time >= timeLimit) std::cout << std::to_string(nbNodesExplored) + " nodes explored - no solution found" << std::endl;
     else std::cout << "infeasible" << std::endl;
     if (state == State::Stop)
@@ -5,8 +5,14 @@
 #include "variablechooser.h"
 #include "valuechooser.h"
 #include "alldifferentfamily.h"
+#include "treedecomposition.h"
+#include "solutionsink.h"
+#include "solutionstream.h"
+#include "arena.h"
 
 #include <memory>  
+#include <climits>
+#include <deque>
 
 struct PairHash {
 public:
@@ -18,8 +24,18 @@ public:
         return hash_combine(std::hash<int>{}(pair.first),pair.second);
     }
 };
+struct VectorHash {
+    std::size_t operator()(const std::vector<int>& values) const {
+        std::size_t seed = values.size();
+        for (int v : values) seed ^= std::hash<int>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
 enum class State {Preprocess, Solve, Stop};
 enum class SolveMethod {ForwardChecking, LazyPropagate, AC3, AC4};
+// Where the search is split into the connected components of the unset variables
+enum class Decomposition {None, Root, Nodes};
 
 class Solver {
 
@@ -36,30 +52,143 @@ private:
     unsigned int randomSeed;
     unsigned int nbSolutions=1;
     bool allDifferent=true;
+    std::string dumpPath;
+    // No presolve messages, for solvers reused on many instances
+    bool quiet=false;
+    // Count the solutions without storing them
+    bool countOnly=false;
+    // Graph coloring: colors unused by the set vertices are interchangeable
+    bool breakColorSymmetry=false;
+    std::unordered_map<int,unsigned int> colorUses;
+    // Graph coloring: look for colorings with fewer and fewer colors
+    bool minimizeColors=false;
+    // Singleton arc consistency at the root, probed by nbThreads solvers for at most
+    // singletonTimeLimit seconds if it is nonnegative
+    bool singletonConsistency=false;
+    double singletonTimeLimit=-1;
+    unsigned int nbThreads=1;
+    Decomposition decomposition=Decomposition::None;
+    // Solvers of the components found at the root, limited to their variables
+    std::vector<std::unique_ptr<Solver>> componentSolvers;
+    // Components left to search once the variables of the current one are set, with the
+    // id of the node which split them
+    std::vector<std::pair<std::vector<int>,unsigned int>> pendingComponents;
+    unsigned int nbSplitNodes=0;
+    // Id of the split node to backtrack to, one of its components has no solution
+    unsigned int unwindTo=0;
+    // Take the tree shaped parts of the constraint graph out of the search
+    bool peelTrees=false;
+    // Peeled variables (var, parent) in peeling order, var is its own parent for tree roots
+    std::vector<std::pair<int,int>> peeledVariables;
+
+    // Backtracking with tree decomposition: the clusters are searched from the root and the
+    // subtree of a cluster is searched once per assignment of its separator
+    bool treeDecompositionSearch=false;
+    std::vector<TreeDecomposition::Cluster> clusters;
+    // Solutions of the subtree of a cluster for one assignment of its separator, a nogood if none
+    struct Good {
+        unsigned long long count=0;
+        // First solution of the subtree, kept unless solutions are only counted
+        std::vector<std::pair<int,int>> solution;
+    };
+    std::vector<std::unordered_map<std::vector<int>,Good,VectorHash>> goods;
+    std::size_t goodsMemory=0;
+    std::size_t goodsBudget=std::size_t(256) << 20;
+    // Counts are only needed up to the number of solutions asked
+    unsigned long long countLimit=1;
+
+    // Temporaries of the search, released level by level with the trail. Declared
+    // before the trail, which is destroyed first.
+    Arena arena;
+    std::vector<Arena::Mark> arenaMarks;
 
     std::unordered_map<int,int> setVariables;
-    std::vector<std::vector<int>> deltaSetVars;
+    std::vector<std::pmr::vector<int>> deltaSetVars;
     std::unordered_set<int> unsetVariables;
-    std::vector<std::vector<std::pair<int,int>>> deltaDomains;
-    std::vector<std::vector<std::tuple<int, int, int, int>>> deltaConstrValPair;
+    // Nodes of the variables moved between setVariables and unsetVariables
+    NodePool<std::unordered_map<int,int>> setVariableNodes;
+    NodePool<std::unordered_set<int>> unsetVariableNodes;
+    std::vector<std::pmr::vector<std::pair<int,int>>> deltaDomains;
+    // Support counts decremented on each level, as (x, y, index of a)
+    std::vector<std::pmr::vector<std::tuple<int, int, int>>> deltaSupportCounts;
+    // Branches (var, domain) left open by a search that stopped on a solution, deepest first
+    std::vector<std::pair<int,std::unordered_set<int>>> openBranches;
+    // A variable of the search, its domain when it was chosen, kept out of the problem
+    // while var is set, and the cursor over its values. trailLevel is the number of
+    // trail levels below its branches.
+    struct Decision {
+        int var;
+        std::unordered_set<int> domain;
+        ValueCursor values;
+        bool exhausted;
+        std::size_t trailLevel;
+        bool triedFreshColor;
+    };
+    // Decisions of the search from the root, decisionDepth of them in use. Entries are
+    // kept between searches so their memory is reused, and stay in place as it grows.
+    std::deque<Decision> decisions;
+    std::size_t decisionDepth=0;
+    // Cursor of chooseValue
+    ValueCursor valueCursor;
 
     std::unordered_set<std::pair<int,int>,PairHash> AC4List;
     std::unordered_set<std::pair<int,int>,PairHash> AC3List;
     std::unordered_set<std::pair<int,int>,PairHash> lazyPropagateList;
+    // Nodes of the entries taken out of the lists
+    NodePool<std::unordered_set<std::pair<int,int>,PairHash>> listNodes;
+    // Number of supports of x=a on (x,y) not yet removed by AC4, for extensive constraints,
+    // at the index of a among the x values of the relation
+    std::unordered_map<std::pair<int,int>,std::vector<unsigned int>,PairHash> supportCounts;
+    // Least constraining value order: per variable, the supports of each of its values in the
+    // domains of its unset extensive neighbors, less the values its intensive constraints
+    // forbid in theirs. Only the variable of a new decision is scored, from the AC4 support
+    // counts when there are some. initSolve makes room for all the values once.
+    bool scoreValues=false;
+    std::unordered_map<int,std::unordered_map<int,long>> valueScores;
+    std::vector<int> scoredValues;
+    // Last support found for x=a on (x,y), for constraints that are not extensive
+    std::unordered_map<std::pair<int,int>,std::unordered_map<int,int>,PairHash> residues;
+    // (y,b) -> values (x,a) whose residue on (x,y) is b
+    std::unordered_map<std::pair<int,int>,std::vector<std::pair<int,int>>,PairHash> residueWatchers;
 
     std::vector<AllDifferentFamily> allDifferentFamilies;
     std::unordered_map<int,std::vector<unsigned int>> varToAllDifferentFamilyIdx; 
 
+    std::vector<std::unique_ptr<Propagator>> propagators;
+    std::unordered_map<int,std::vector<unsigned int>> varToPropagatorIdx;
+    // Propagators to run, one of their variables lost a value
+    std::vector<unsigned int> propagatorQueue;
+    std::vector<bool> isQueuedPropagator;
+    // Variables of each propagator that lost values since it last ran
+    std::vector<std::vector<int>> propagatorChanges;
+    // Buffers of runPropagators: the removals of a propagator and the changes it reads
+    std::vector<std::pair<int,int>> propagatorRemovals;
+    std::vector<int> propagatorChanged;
+    // Buffers of forwardChecking, AC3 and AC4, which are not reentrant
+    std::vector<int> forbiddenValues;
+    std::vector<int> unsupportedValues;
+    std::vector<int> supportValues;
+    std::vector<std::pair<int,int>> toPropagate;
+    std::vector<std::pair<int,int>> unsupportedPairs;
+    std::vector<std::pair<int,int>> revisedWatchers;
+
     State state = State::Preprocess;
-    unsigned int nbNodesExplored=0;
+    unsigned long nbNodesExplored=0;
+    unsigned long nbRevisions=0;
+    unsigned long nbRemovals=0;
     int bestDepth=0;
     clock_t start_time;
     clock_t solve_time=0.;
     std::vector<std::unordered_map<int,int>> solutions;
+    unsigned long long nbSolutionsFound=0;
+    // Receives the solutions instead of solutions if set, as values of sinkVariables
+    std::unique_ptr<SolutionSink> solutionSink;
+    std::vector<int> sinkVariables;
+    std::vector<int> sinkValues;
 
 public:
-    Solver(CSP _problem, const std::vector<std::string> _parameters, bool _verbosity);
-    Solver(CSP _problem);
+    Solver(const CSP& _problem, const std::vector<std::string> _parameters, bool _verbosity);
+    Solver(const CSP& _problem);
     void translateParameters(const std::vector<std::string> _parameters);
     void setDefaultParameters();
 
@@ -73,55 +202,170 @@ public:
     void setVerbosity(const bool _verbosity) {verbosity=_verbosity;}
     void setNbSolutions(const unsigned int _nbSolutions);
     void setAllDifferent(const bool _allDifferent);
+    // Write the model to dumpPath once root propagation is done
+    void setDumpPath(const std::string _dumpPath) {dumpPath = _dumpPath;}
+    void setQuiet(const bool _quiet) {quiet = _quiet;}
+    void setCountOnly(const bool _countOnly) {countOnly = _countOnly;}
+    bool isCountOnly() const {return countOnly;}
+    void setMinimizeColors(const bool _minimizeColors);
+    // Try a single unused color at each branch. The colorings found are then one per
+    // permutation of the unused colors, which suits one solution or an optimization.
+    void setBreakColorSymmetry(const bool _breakColorSymmetry);
+    void setSingletonConsistency(const bool _singletonConsistency) {singletonConsistency = _singletonConsistency;}
+    void setSingletonTimeLimit(const double _singletonTimeLimit) {singletonTimeLimit = _singletonTimeLimit;}
+    void setNbThreads(const unsigned int _nbThreads) {nbThreads = std::max(_nbThreads, 1u);}
+    void setDecomposition(const std::string _decomposition);
+    void setPeelTrees(const bool _peelTrees) {peelTrees = _peelTrees;}
+    // Pass the solutions to sink instead of keeping them
+    void setSolutionSink(std::unique_ptr<SolutionSink> sink);
+    // Solve lazily, as in for (const auto& solution : solver.streamSolutions())
+    SolutionStream streamSolutions() {return SolutionStream(*this);}
+    void setTreeDecompositionSearch(const bool _treeDecompositionSearch) {treeDecompositionSearch = _treeDecompositionSearch;}
+    // Memory of the goods and nogoods of the tree decomposition search, in bytes
+    void setGoodsBudget(const std::size_t bytes) {goodsBudget = bytes;}
     void initAllDifferent();
+    void initPropagators();
 
     bool feasible() const{return problem.feasible(setVariables);}
     bool feasible(int var, int value) const {return problem.feasible(setVariables,var,value);}
-    void checkFeasibility(CSP _problem);
+    void checkFeasibility(const CSP& _problem);
     void preprocess();
     bool presolve();
+    // Remove the values whose assignment is inconsistent, probed in parallel by round
+    bool singletonArcConsistency();
+    // Set the unset variables with a single value left, until none is left
+    bool setSingletons();
+    // Remove from the search the variables with at most one unset neighbor, until none is left,
+    // keeping a support in each of them for the values of their parent
+    bool peelForests();
+    // Give the peeled variables values compatible with their parent in solution
+    void completePeeled(std::unordered_map<int,int>& solution) const;
+    // Run root preprocessing/presolve and switch to the node solve method
+    bool initSolve();
+    // Solve the instance obtained by removing these values, after initSolve(), then
+    // restore the root state through the trail. Return true if a solution was found.
+    bool solveWithRemovals(const std::vector<std::pair<int,int>>& removals);
+    // Remove these values below any search, at a trail level which is never backtracked
+    bool removeAtRoot(const std::vector<std::pair<int,int>>& removals);
+    // Assign value to var after initSolve() and propagate, then backtrack
+    bool probe(int var, int value);
+    // Backtrack the branches left open by the last search
+    void closeOpenBranches();
     void launchSolve();
+    void stop();
+    // Connected components of the unset variables through constraints, propagators and families
+    std::vector<std::vector<int>> findComponents() const;
+    // Build a solver for each component of the root, if there are several. False if the
+    // presolve of one of them fails, the whole problem is then inconsistent.
+    bool initComponentSolvers();
+    // Solve the root components in parallel, then combine their solutions as a product
+    void launchComponents();
+    // Search the components of the current node one after the other
+    bool splitSolve(std::vector<std::vector<int>>& components);
+    // Count the solutions of the components of the current node and add their product
+    bool splitCount(std::vector<std::vector<int>>& components);
+    // Search with a tree decomposition of the unset variables instead of search
+    void treeDecompositionSolve();
+    // Number of solutions of the subtree of the cluster, at most countLimit, with the
+    // variables of its ancestors set. The first one is written to solution if given.
+    unsigned long long clusterSolve(std::size_t idx, std::vector<std::pair<int,int>>* solution);
+    // Same, once the proper variables of the cluster are set
+    unsigned long long clusterChildrenSolve(std::size_t idx, std::vector<std::pair<int,int>>* solution);
+    // Search the last pending component, once the variables of the current one are set
+    bool solvePendingComponent();
+    // Solve again after each coloring with the colors beyond its number minus one removed,
+    // until the clique lower bound is met or no coloring is left
+    void minimizeNbColors();
+    // Count the solutions of a queens problem with bitboards instead of searching
+    void countQueens();
+    void addSolution();
+    // Complete the peeled variables of solution and keep it or pass it to the sink
+    void storeSolution(const std::unordered_map<int,int>& solution);
     void timeThread();
+    // New level of the trail, and of the arena
+    void pushTrailLevel();
     void branchOnVar(int var, int value);
-    void unbranchOnVar(int var, std::vector<int> values);
+    // Branch on var=value and propagate, undo the branch if it is inconsistent. domain is
+    // the domain of var before its first branch.
+    bool branch(int var, int value, const std::unordered_set<int>& domain);
+    // Give var back its domain, swapped with domain
+    void unbranchOnVar(int var, std::unordered_set<int>& domain);
     void solve();
     void backtrack();
-    bool recursiveSolve();
+    // Depth first search of the unset variables with a stack of decisions, true if it
+    // stopped on the last solution wanted, with its branches left open
+    bool search();
+    void openDecision(int var);
+    // Branch on the next value of the decision, false once they are all tried
+    bool nextBranch(Decision& decision);
     bool checkConsistent(int var, int value);
     
     bool forwardChecking(int x, int a);
     bool lazyPropagate(int x, int a);
+    bool lazyPropagate();
     void removeLazyPropagateList(int x, int a);
 
-    void cleanConstraints();
+    void extensifyConstraints();
+    void initSupportCounts();
+    bool hasResidualSupport(int x, int y, int a);
+    bool hasSupport(int x, int y, int a);
+    void reviseResidues(int y, int b, std::vector<std::pair<int,int>>& unsupported);
     bool initAC4Root();
-    bool initAC4Solve(int var, int value, std::vector<int> values);    
+    bool initAC4Solve(int var, int value, const std::unordered_set<int>& oldDomain);    
     bool AC4();
     bool initAC3Root();
     bool initAC3Solve(int var);
     bool AC3();
     bool checkAC();
-    void addAC4List(int x, int a) {AC4List.emplace(std::make_pair(x, a));}
-    void addAC3List(int x, int y) {AC3List.emplace(std::make_pair(x, y));}
+    void addAC4List(int x, int a) {listNodes.insert(AC4List, std::make_pair(x, a));}
+    void addAC3List(int x, int y) {listNodes.insert(AC3List, std::make_pair(x, y));}
     void removeAC4List(int x, int a);
     void removeAC3List(int x, int y);
 
+    void schedulePropagator(unsigned int idx);
+    void schedulePropagators(int var);
+    void clearPropagatorQueue();
+    bool removePropagatedValue(int var, int value);
+    bool runPropagators();
+    // Run the scheduled propagators and the propagation of their removals until fixpoint
+    bool propagateFixpoint();
+    // Propagate the removals of the solve method lists and the propagators
+    bool propagateRemovals();
+
     int chooseVar() {return varChooser->choose(problem,unsetVariables);}
-    std::vector<int> chooseValue(int var) {return valueChooser->choose(problem,var);}
+    std::vector<int> chooseValue(int var) {
+        std::vector<int> values;
+        chooseValue(var, values);
+        return values;
+    }
+    // Same, reusing the memory of values
+    void chooseValue(int var, std::vector<int>& values) {
+        if (scoreValues) scoreDomain(var, problem.getDomain(var));
+        valueChooser->choose(var, problem.getDomain(var), valueCursor, values);
+    }
 
     void setVar(int var, int value);
     void unsetVar(int var);
     bool removeVarValue(int var, int value);
     void addVarValue(int var, int value);
-    void removeConstraintValuePair(int x, int y, int a, int b);
+    // Return the support count of x=a on (x,y) once decremented
+    unsigned int decrementSupportCount(int x, int y, int a);
     void updateAddAllDiff(int var, int value);
     bool updateRemoveAllDiff(int var, int value);
-    bool updateSetAllDiff(int var, int value, const std::vector<int>& values);
-    void backtrackAllDiff(int var, const std::vector<int>& values);
-    bool fixVariables(const std::vector<std::pair<int,int>>& varsToFix);
+    bool updateSetAllDiff(int var, int value, const std::unordered_set<int>& domain);
+    void backtrackAllDiff(int var, const std::unordered_set<int>& domain);
+    void initValueScores();
+    // Score the values of domain, which var is chosen with, against the current domains
+    void scoreDomain(int var, const std::unordered_set<int>& domain);
+    bool fixVariables(const std::pmr::vector<std::pair<int,int>>& varsToFix);
     std::unordered_map<int,int> retrieveSolution() const{return setVariables;}
-    unsigned int getNbNodesExplored() const{return nbNodesExplored;}
-    bool hasFoundSolution() const {return (solutions.size() > 0);}
+    unsigned long getNbNodesExplored() const{return nbNodesExplored;}
+    unsigned long getNbRevisions() const{return nbRevisions;}
+    unsigned long getNbRemovals() const{return nbRemovals;}
+    const CSP& getProblem() const{return problem;}
+    bool hasFoundSolution() const {return (nbSolutionsFound > 0);}
+    unsigned long long getNbSolutionsFound() const{return nbSolutionsFound;}
+    const std::vector<std::unordered_map<int,int>>& getSolutions() const{return solutions;}
 
     void solveVerbosity();
     void displayModelInformation() const;
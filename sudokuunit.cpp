@@ -0,0 +1,152 @@
+#include <iostream>
+#include <cassert>
+#include <stdexcept>
+#include <algorithm>
+
+#include "sudokuunit.h"
+
+static unsigned int popcount(uint64_t mask) {
+    return (unsigned int)(__builtin_popcountll(mask));
+}
+
+SudokuUnitPropagator::SudokuUnitPropagator(std::vector<int> _cells) : cells{_cells} {
+    if (cells.size() > 64) throw std::logic_error("Sudoku units are limited to 64 cells");
+    candidates.resize(cells.size());
+    initialCandidates.resize(cells.size());
+    positions.resize(cells.size());
+}
+
+bool SudokuUnitPropagator::findHallSets(const std::vector<uint64_t>& items) {
+    hallSets.clear();
+    smallItems.clear();
+    for (unsigned int i=0; i<items.size(); i++) {
+        // Items with a single bit are singles, already applied
+        unsigned int nbBits = popcount(items[i]);
+        if (nbBits >= 2 && nbBits <= MAX_SUBSET) smallItems.push_back(i);
+    }
+    return searchHallSets(items, 0, 0, 0, 0);
+}
+
+bool SudokuUnitPropagator::searchHallSets(const std::vector<uint64_t>& items, unsigned int start, uint64_t members, uint64_t cover, unsigned int size) {
+    for (unsigned int k=start; k<smallItems.size(); k++) {
+        unsigned int i = smallItems[k];
+        uint64_t newCover = cover | items[i];
+        unsigned int nbCovered = popcount(newCover);
+        if (nbCovered > MAX_SUBSET) continue;
+        uint64_t newMembers = members | (uint64_t(1) << i);
+        if (nbCovered < size + 1) return false;
+        if (nbCovered == size + 1) hallSets.push_back(std::make_pair(newMembers, newCover));
+        else if (!searchHallSets(items, k + 1, newMembers, newCover, size + 1)) return false;
+    }
+    return true;
+}
+
+void SudokuUnitPropagator::computePositions() {
+    std::fill(positions.begin(), positions.end(), 0);
+    for (unsigned int p=0; p<cells.size(); p++) {
+        for (uint64_t values=candidates[p]; values; values &= values - 1) {
+            positions[(std::size_t)(__builtin_ctzll(values))] |= uint64_t(1) << p;
+        }
+    }
+}
+
+bool SudokuUnitPropagator::propagateSingles() {
+    const unsigned int n = (unsigned int)(cells.size());
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        // Naked singles: the value of a fixed cell is removed from the others
+        uint64_t fixed = 0;
+        for (unsigned int p=0; p<n; p++) {
+            if (!candidates[p]) return false;
+            if (popcount(candidates[p]) > 1) continue;
+            if (fixed & candidates[p]) return false;
+            fixed |= candidates[p];
+        }
+        for (unsigned int p=0; p<n; p++) {
+            if (popcount(candidates[p]) == 1 || !(candidates[p] & fixed)) continue;
+            candidates[p] &= ~fixed;
+            changed = true;
+        }
+
+        // Hidden singles: a value with a single possible cell is fixed there
+        computePositions();
+        for (unsigned int v=0; v<n; v++) {
+            if (!positions[v]) return false;
+            if (popcount(positions[v]) > 1) continue;
+            unsigned int p = (unsigned int)(__builtin_ctzll(positions[v]));
+            if (candidates[p] == uint64_t(1) << v) continue;
+            candidates[p] = uint64_t(1) << v;
+            changed = true;
+        }
+    }
+    return true;
+}
+
+bool SudokuUnitPropagator::propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove) {
+    const unsigned int n = (unsigned int)(cells.size());
+    for (unsigned int p=0; p<n; p++) {
+        candidates[p] = 0;
+        for (int value : domains.at(cells[p])) {
+            assert(value >= 1 && value <= int(n));
+            candidates[p] |= uint64_t(1) << (value - 1);
+        }
+        initialCandidates[p] = candidates[p];
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        if (!propagateSingles()) return false;
+
+        // Naked subsets: k cells with k candidates between them, which the other cells lose
+        if (!findHallSets(candidates)) return false;
+        for (auto [members, values] : hallSets) {
+            for (unsigned int p=0; p<n; p++) {
+                if ((members >> p) & 1 || !(candidates[p] & values)) continue;
+                candidates[p] &= ~values;
+                if (!candidates[p]) return false;
+                changed = true;
+            }
+        }
+
+        // Hidden subsets: k values with k cells between them, which lose their other candidates
+        computePositions();
+        if (!findHallSets(positions)) return false;
+        for (auto [values, members] : hallSets) {
+            for (unsigned int p=0; p<n; p++) {
+                if (!((members >> p) & 1) || !(candidates[p] & ~values)) continue;
+                candidates[p] &= values;
+                changed = true;
+            }
+        }
+    }
+
+    for (unsigned int p=0; p<n; p++) {
+        uint64_t removed = initialCandidates[p] & ~candidates[p];
+        while (removed) {
+            toRemove.push_back(std::make_pair(cells[p], __builtin_ctzll(removed) + 1));
+            removed &= removed - 1;
+        }
+    }
+    return true;
+}
+
+bool SudokuUnitPropagator::feasible(const std::unordered_map<int,int>& partSol) const {
+    uint64_t used = 0;
+    for (int cell : cells) {
+        auto it = partSol.find(cell);
+        if (it == partSol.end()) continue;
+        uint64_t bit = uint64_t(1) << (it->second - 1);
+        if (used & bit) return false;
+        used |= bit;
+    }
+    return true;
+}
+
+void SudokuUnitPropagator::display() const {
+    std::cout << "Sudoku unit:";
+    for (int cell : cells) std::cout << " " << cell;
+    std::cout << std::endl;
+}
@@ -0,0 +1,45 @@
+#ifndef SUDOKU_UNIT_H_
+#define SUDOKU_UNIT_H_
+
+#include <cstdint>
+
+#include "propagator.h"
+
+// Row, column or box of a n² x n² sudoku, with one bitmask of candidates per
+// cell (bit v-1 for value v, so at most 64 values). Filters naked and hidden
+// singles, then naked and hidden subsets of up to MAX_SUBSET cells, until fixpoint.
+class SudokuUnitPropagator : public Propagator {
+
+private:
+    static const unsigned int MAX_SUBSET = 4;
+
+    std::vector<int> cells;
+
+    // Scratch buffers of propagate
+    std::vector<uint64_t> candidates;
+    std::vector<uint64_t> initialCandidates;
+    std::vector<uint64_t> positions; // bitmask of the cells of each value
+    std::vector<unsigned int> smallItems; // items covering at most MAX_SUBSET bits
+    std::vector<std::pair<uint64_t,uint64_t>> hallSets;
+
+    // Append to hallSets the sets of items whose masks cover as many bits as there are items,
+    // return false if some items cover fewer bits
+    bool findHallSets(const std::vector<uint64_t>& items);
+    void computePositions();
+    // Naked and hidden singles until fixpoint, return false on a contradiction
+    bool propagateSingles();
+    bool searchHallSets(const std::vector<uint64_t>& items, unsigned int start, uint64_t members, uint64_t cover, unsigned int size);
+
+public:
+    SudokuUnitPropagator(std::vector<int> _cells);
+
+    std::unique_ptr<Propagator> clone() const{return std::make_unique<SudokuUnitPropagator>(*this);}
+    const std::vector<int>& getVariables() const{return cells;}
+
+    bool propagate(const std::unordered_map<int,std::unordered_set<int>>& domains, std::vector<std::pair<int,int>>& toRemove);
+    bool feasible(const std::unordered_map<int,int>& partSol) const;
+
+    void display() const;
+};
+
+#endif
@@ -13,7 +13,7 @@ if __name__ == "__main__":
         parameters = test.split(" ")
         file = parameters[0]
         print(file)
-        result = subprocess.Popen(['./run.exe', './Tests/' + file, parameters[1], parameters[2],  parameters[3],  parameters[4],  '0', parameters[5], parameters[6], parameters[7], "1", "0", parameters[8], parameters[9]], stdout=subprocess.PIPE, text=True, stderr=subprocess.PIPE)
+        result = subprocess.Popen(['./run.exe', './Tests/' + file, parameters[1], parameters[2],  parameters[3],  parameters[4],  '0', parameters[5], parameters[6], parameters[7], "1", "0", parameters[8], parameters[9]] + parameters[10:], stdout=subprocess.PIPE, text=True, stderr=subprocess.PIPE)
         hasError = False
         for err in result.stderr:
             errors.append([file, err])
@@ -0,0 +1,54 @@
+#include <stdexcept>
+#include <climits>
+
+#include "tokenizer.h"
+
+void Tokenizer::skipBlanks() {
+    while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r')) cur++;
+}
+
+bool Tokenizer::eol() {
+    skipBlanks();
+    return cur >= end || *cur == '\n';
+}
+
+void Tokenizer::nextLine() {
+    while (cur < end && *cur != '\n') cur++;
+    if (cur < end) cur++;
+}
+
+std::string_view Tokenizer::word() {
+    skipBlanks();
+    const char* start = cur;
+    while (cur < end && *cur != ' ' && *cur != '\t' && *cur != '\r' && *cur != '\n') cur++;
+    return std::string_view(start, std::size_t(cur - start));
+}
+
+bool Tokenizer::nextInt(int& value) {
+    if (eol()) return false;
+    bool negative = (*cur == '-');
+    if (*cur == '-' || *cur == '+') cur++;
+    if (cur >= end || *cur < '0' || *cur > '9') throw std::logic_error("Expected an integer in instance file");
+    // Wider than int, so that a value out of its range is caught before it overflows
+    long long result = 0;
+    const long long limit = negative ? -(long long)(INT_MIN) : (long long)(INT_MAX);
+    while (cur < end && *cur >= '0' && *cur <= '9') {
+        result = 10*result + (*cur - '0');
+        if (result > limit) throw std::logic_error("Integer out of range in instance file");
+        cur++;
+    }
+    value = int(negative ? -result : result);
+    return true;
+}
+
+int Tokenizer::readInt() {
+    int value;
+    if (!nextInt(value)) throw std::logic_error("Unexpected end of line in instance file");
+    return value;
+}
+
+unsigned int Tokenizer::readUnsigned() {
+    int value = readInt();
+    if (value < 0) throw std::logic_error("Expected a non negative integer in instance file");
+    return (unsigned int)(value);
+}
@@ -0,0 +1,37 @@
+#ifndef TOKENIZER_H_
+#define TOKENIZER_H_
+
+#include <string>
+#include <string_view>
+
+#include "mappedfile.h"
+
+// Line-aware integer parsing over a whole mapped instance file, without any
+// per-token allocation
+class Tokenizer {
+
+private:
+    MappedFile file;
+    const char* cur;
+    const char* end;
+
+    void skipBlanks();
+
+public:
+    Tokenizer(const std::string& path) : file(path), cur{file.data()}, end{file.data() + file.size()} {}
+
+    bool eof() const{return cur >= end;}
+    // True if there is no more token on the current line
+    bool eol();
+    // Go to the beginning of the next line
+    void nextLine();
+
+    // Next whitespace separated token of the current line, empty at the end of the line
+    std::string_view word();
+    // Parse the next integer of the current line, return false at the end of the line
+    bool nextInt(int& value);
+    int readInt();
+    unsigned int readUnsigned();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <set>
+#include <tuple>
+#include <algorithm>
+
+#include "treedecomposition.h"
+
+std::size_t TreeDecomposition::fill(const std::unordered_map<int,std::unordered_set<int>>& graph, int vertex) {
+    const std::unordered_set<int>& neighbors = graph.at(vertex);
+    if (neighbors.size() > MAX_FILL_DEGREE) return neighbors.size() * (neighbors.size() - 1) / 2;
+    std::size_t missing = 0;
+    for (int a : neighbors) {
+        const std::unordered_set<int>& aNeighbors = graph.at(a);
+        for (int b : neighbors) {
+            if (a < b && !aNeighbors.count(b)) missing++;
+        }
+    }
+    return missing;
+}
+
+TreeDecomposition::TreeDecomposition(std::unordered_map<int,std::unordered_set<int>> graph) {
+    // Min-fill order, the fill of the neighbors of an eliminated vertex is updated
+    std::set<std::tuple<std::size_t,std::size_t,int>> queue;
+    std::unordered_map<int,std::pair<std::size_t,std::size_t>> keys;
+    for (const auto& [vertex,neighbors] : graph) {
+        keys[vertex] = std::make_pair(fill(graph, vertex), neighbors.size());
+        queue.emplace(keys[vertex].first, keys[vertex].second, vertex);
+    }
+    std::vector<int> order;
+    std::unordered_map<int,std::size_t> position;
+    std::unordered_map<int,std::vector<int>> higherNeighbors;
+    while (!queue.empty()) {
+        int vertex = std::get<2>(*queue.begin());
+        queue.erase(queue.begin());
+        position[vertex] = order.size();
+        order.push_back(vertex);
+        std::vector<int> neighbors(graph.at(vertex).begin(), graph.at(vertex).end());
+        for (int a : neighbors) {
+            graph.at(a).erase(vertex);
+            for (int b : neighbors) {
+                if (a != b) graph.at(a).insert(b);
+            }
+        }
+        graph.erase(vertex);
+        for (int a : neighbors) {
+            queue.erase(std::make_tuple(keys[a].first, keys[a].second, a));
+            keys[a] = std::make_pair(fill(graph, a), graph.at(a).size());
+            queue.emplace(keys[a].first, keys[a].second, a);
+        }
+        higherNeighbors[vertex] = std::move(neighbors);
+    }
+
+    // Clusters from the last eliminated vertex, parents before children
+    std::unordered_map<int,std::size_t> clusterOf;
+    for (auto it=order.rbegin(); it!=order.rend(); it++) {
+        int vertex = *it;
+        std::vector<int>& higher = higherNeighbors.at(vertex);
+        if (higher.empty()) {
+            roots.push_back(clusters.size());
+            clusterOf[vertex] = clusters.size();
+            clusters.push_back(Cluster{{vertex}, {}, {}});
+            continue;
+        }
+        int first = *std::min_element(higher.begin(), higher.end(), [&position](int a, int b) {return position.at(a) < position.at(b);});
+        std::size_t parent = clusterOf.at(first);
+        // The higher neighbors are in the cluster of the first of them
+        if (higher.size() == clusters[parent].proper.size() + clusters[parent].separator.size()) {
+            clusters[parent].proper.push_back(vertex);
+            clusterOf[vertex] = parent;
+        } else {
+            clusters[parent].children.push_back(clusters.size());
+            clusterOf[vertex] = clusters.size();
+            std::sort(higher.begin(), higher.end());
+            clusters.push_back(Cluster{{vertex}, std::move(higher), {}});
+        }
+    }
+    for (const Cluster& cluster : clusters) {
+        width = std::max(width, cluster.proper.size() + cluster.separator.size() - 1);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef TREE_DECOMPOSITION_H_
+#define TREE_DECOMPOSITION_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Tree decomposition of a graph, built from a min-fill elimination order. The cluster
+// of a vertex is the vertex and its neighbors eliminated after it. A cluster equal to
+// the higher neighbors of a vertex takes the vertex instead of getting a child.
+class TreeDecomposition {
+
+public:
+    struct Cluster {
+        // Vertices of the cluster which belong to no ancestor
+        std::vector<int> proper;
+        // Vertices shared with the parent cluster
+        std::vector<int> separator;
+        std::vector<std::size_t> children;
+    };
+
+private:
+    std::vector<Cluster> clusters;
+    // One root cluster per connected component
+    std::vector<std::size_t> roots;
+    std::size_t width=0;
+
+    // Above this degree the fill of a vertex is not counted but bounded by all its pairs
+    static const std::size_t MAX_FILL_DEGREE = 64;
+
+    static std::size_t fill(const std::unordered_map<int,std::unordered_set<int>>& graph, int vertex);
+
+public:
+    explicit TreeDecomposition(std::unordered_map<int,std::unordered_set<int>> graph);
+
+    const std::vector<Cluster>& getClusters() const{return clusters;}
+    const std::vector<std::size_t>& getRoots() const{return roots;}
+    // Size of the largest cluster minus one
+    std::size_t getWidth() const{return width;}
+};
+
+#endif
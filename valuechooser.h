@@ -2,54 +2,147 @@
 #define VALUE_CHOOSER_H_
 
 #include "csp.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 
+// Position of a value chooser in the domain of a decision, which must not change until
+// the cursor is done
+struct ValueCursor {
+    int var=0;
+    const std::unordered_set<int>* domain=nullptr;
+    std::unordered_set<int>::const_iterator position;
+    // All the values, ordered once more than one of them is asked for
+    std::vector<int> pending;
+    std::size_t nbGiven=0;
+    int first=0;
+};
+
+// Gives the values of a decision one at a time. Most decisions only try their first
+// value, which is found without copying or ordering the domain.
 class ValueChooser {
 public:
     virtual ~ValueChooser(){};
-    virtual std::vector<int> choose(const CSP& problem, int var)const=0;
+    virtual void start(int var, const std::unordered_set<int>& domain, ValueCursor& cursor) const=0;
+    // Next value to try, false once they were all given
+    virtual bool next(ValueCursor& cursor, int& value) const=0;
+
+    // Fill order with all the values of the domain of var in the order to try them
+    void choose(int var, const std::unordered_set<int>& domain, ValueCursor& cursor, std::vector<int>& order) const{
+        start(var, domain, cursor);
+        order.clear();
+        int value;
+        while (next(cursor, value)) order.push_back(value);
+    }
 };
 
+// Values in the order of the domain, read in place
 class CopyValueChooser : public ValueChooser {
-protected:
-    std::vector<int> choose(const CSP& problem, int var) const{
-        std::vector<int> order;
-        order.insert(order.end(), problem.getDomain(var).begin(), problem.getDomain(var).end());
-        return order;
+public:
+    void start(int var, const std::unordered_set<int>& domain, ValueCursor& cursor) const{
+        cursor.var = var;
+        cursor.domain = &domain;
+        cursor.position = domain.begin();
+    }
+    bool next(ValueCursor& cursor, int& value) const{
+        if (cursor.position == cursor.domain->end()) return false;
+        value = *cursor.position++;
+        return true;
+    }
+};
+
+// Values in the order of Derived::before(var, a, b), which must be a strict total order.
+// The first one is found by a scan, the others are sorted when the second one is asked for.
+template<typename Derived>
+class OrderedValueChooser : public ValueChooser {
+public:
+    void start(int var, const std::unordered_set<int>& domain, ValueCursor& cursor) const{
+        cursor.var = var;
+        cursor.domain = &domain;
+        cursor.nbGiven = 0;
+    }
+    bool next(ValueCursor& cursor, int& value) const{
+        const Derived& order = static_cast<const Derived&>(*this);
+        if (cursor.nbGiven == cursor.domain->size()) return false;
+        if (cursor.nbGiven == 0) {
+            auto best = cursor.domain->begin();
+            for (auto it=best; it!=cursor.domain->end(); it++) {
+                if (order.before(cursor.var, *it, *best)) best = it;
+            }
+            value = *best;
+        } else {
+            if (cursor.nbGiven == 1) {
+                cursor.pending.assign(cursor.domain->begin(), cursor.domain->end());
+                int var = cursor.var;
+                std::sort(cursor.pending.begin(), cursor.pending.end(), [&order, var](int a, int b) {return order.before(var, a, b);});
+            }
+            value = cursor.pending[cursor.nbGiven];
+        }
+        cursor.nbGiven++;
+        return true;
     }
 };
 
-class SmallestValueChooser : public ValueChooser {
-protected:
-    std::vector<int> choose(const CSP& problem, int var) const{
-        std::vector<int> order;
-        order.insert(order.end(), problem.getDomain(var).begin(), problem.getDomain(var).end());
-        std::sort(order.begin(), order.end());
-        return order;
+class SmallestValueChooser : public OrderedValueChooser<SmallestValueChooser> {
+public:
+    bool before(int, int a, int b) const{return a < b;}
+};
+
+// Ties of the function are broken by value
+class LambdaValueChooser : public OrderedValueChooser<LambdaValueChooser> {
+private:
+    std::function<bool(int,int)> sortFunction;
+
+public:
+    LambdaValueChooser(std::function<bool(int,int)> _sortFunction) : sortFunction{_sortFunction} {}
+    bool before(int, int a, int b) const{return sortFunction(a, b) || (!sortFunction(b, a) && a < b);}
+};
+
+// Least constraining value: the values leaving the most supports in the domains of the
+// neighbors first, ties broken by value. The solver scores the values of a decision before
+// it starts.
+class LeastConstrainingValueChooser : public OrderedValueChooser<LeastConstrainingValueChooser> {
+private:
+    const std::unordered_map<int,std::unordered_map<int,long>>& scores;
+
+public:
+    explicit LeastConstrainingValueChooser(const std::unordered_map<int,std::unordered_map<int,long>>& _scores) : scores{_scores} {}
+    bool before(int var, int a, int b) const{
+        const std::unordered_map<int,long>& varScores = scores.at(var);
+        long scoreA = varScores.at(a);
+        long scoreB = varScores.at(b);
+        return scoreA > scoreB || (scoreA == scoreB && a < b);
     }
 };
 
+// Values drawn one at a time. The first one is read in place, the others are drawn
+// by a partial Fisher-Yates shuffle when the second one is asked for.
 class RandomValueChooser : public ValueChooser {
-protected:
-    std::vector<int> choose(const CSP& problem, int var) const{
-        std::vector<int> order;
-        order.insert(order.end(), problem.getDomain(var).begin(), problem.getDomain(var).end());
-        std::random_shuffle (order.begin(), order.end());
-        return order;
-    }
-};
-
-class LambdaValueChooser : public ValueChooser {
-    protected:
-        std::function<bool(int,int)> sortFunction;
-        std::vector<int> choose(const CSP& problem, int var) const{
-            std::vector<int> order;
-            order.insert(order.end(), problem.getDomain(var).begin(), problem.getDomain(var).end());
-            std::sort(order.begin(), order.end(), sortFunction);
-            return order;
+public:
+    void start(int var, const std::unordered_set<int>& domain, ValueCursor& cursor) const{
+        cursor.var = var;
+        cursor.domain = &domain;
+        cursor.nbGiven = 0;
+    }
+    bool next(ValueCursor& cursor, int& value) const{
+        std::size_t size = cursor.domain->size();
+        if (cursor.nbGiven == size) return false;
+        if (cursor.nbGiven == 0) {
+            auto it = cursor.domain->begin();
+            std::advance(it, (std::size_t)(rand()) % size);
+            value = cursor.first = *it;
+        } else {
+            if (cursor.nbGiven == 1) {
+                cursor.pending.assign(cursor.domain->begin(), cursor.domain->end());
+                std::swap(cursor.pending[0], *std::find(cursor.pending.begin(), cursor.pending.end(), cursor.first));
+            }
+            std::size_t pick = cursor.nbGiven + (std::size_t)(rand()) % (size - cursor.nbGiven);
+            std::swap(cursor.pending[cursor.nbGiven], cursor.pending[pick]);
+            value = cursor.pending[cursor.nbGiven];
         }
-    public:
-        LambdaValueChooser(std::function<bool(int,int)> _sortFunction) : ValueChooser(), sortFunction{_sortFunction} {};
+        cursor.nbGiven++;
+        return true;
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
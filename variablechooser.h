@@ -3,6 +3,7 @@
 
 #include "csp.h"
 #include <cassert>
+#include <climits>
 
 class VariableChooser {
 public:
@@ -39,6 +40,33 @@ protected:
     }
 };
 
+// DSATUR: highest saturation degree, ties broken by the number of unset neighbors.
+// Forward checking removes from a domain the colors of its neighbors, so the
+// saturation degree is read from the domain size kept by the trail.
+class DSaturVariableChooser : public VariableChooser {
+protected:
+    int choose(const CSP& problem, const std::unordered_set<int>& variables) const{
+        size_t bestSize = INT_MAX;
+        for (int var : variables) {
+            bestSize = std::min(bestSize, problem.getDomainSize(var));
+        }
+        int bestVar = -1;
+        int bestDegree = -1;
+        for (int var : variables) {
+            if (problem.getDomainSize(var) != bestSize) continue;
+            int degree = 0;
+            for (const auto& [y, Cxy] : problem.getConstraints().at(var)) {
+                degree += int(variables.count(y));
+            }
+            if (degree > bestDegree) {
+                bestDegree = degree;
+                bestVar = var;
+            }
+        }
+        return bestVar;
+    }
+};
+
 class MaxConstraintVariableChooser : public VariableChooser {
 protected:
     int choose(const CSP& problem, const std::unordered_set<int>& variables) const{